@@ -1 +1 @@
-gcc -Os -s -flto -std=c99 -DHAVE_CURL -D_DEBUG -D_POSIX_C_SOURCE=200809 *.c jfes/*.c -o toy -lcurl -lglfw -ldl -lm
\ No newline at end of file
+gcc -Os -s -flto -std=c99 -DHAVE_CURL -DHAVE_EGL -D_DEBUG -D_POSIX_C_SOURCE=200809 *.c jfes/*.c -o toy -lcurl -lglfw -lEGL -ldl -lm -pthread
\ No newline at end of file
@@ -7,6 +7,22 @@
 
 #include "jfes.h"
 
+/* Vector string scanning, define JFES_NO_SIMD to build only the portable code. */
+#if !defined(JFES_NO_SIMD) && (defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2))
+    #define JFES_SIMD_SSE2
+    #include <emmintrin.h>
+    #if (defined(__GNUC__) || defined(__clang__)) && (defined(__x86_64__) || defined(__i386__))
+        #define JFES_SIMD_AVX2
+        #include <immintrin.h>
+    #endif
+    #ifdef _MSC_VER
+        #include <intrin.h>
+    #endif
+#elif !defined(JFES_NO_SIMD) && defined(__ARM_NEON) && defined(__aarch64__)
+    #define JFES_SIMD_NEON
+    #include <arm_neon.h>
+#endif
+
 /** Needed for the buffer in jfes_(int/double)_to_string(_r). */
 #define JFES_MAX_DIGITS                 64
 
@@ -20,6 +36,28 @@
 /** Needed for the jfes_is_null function */
 #define JFES_NULL_VALUE                 "null"
 
+/** Default size of the arena block. */
+#define JFES_ARENA_BLOCK_SIZE           (64 * 1024)
+
+/** Alignment of the arena allocations. */
+#define JFES_ARENA_ALIGNMENT            8
+
+/** JFES arena block header, the block bytes follow it. */
+struct jfes_arena_block {
+    jfes_arena_block_t      *next;              /**< Next block. */
+    jfes_size_t             size;               /**< Block bytes count. */
+    jfes_size_t             used;               /**< Used bytes count. */
+};
+
+/** Size of the arena block header with the alignment. */
+#define JFES_ARENA_HEADER_SIZE          ((sizeof(jfes_arena_block_t) + JFES_ARENA_ALIGNMENT - 1) & ~(JFES_ARENA_ALIGNMENT - 1))
+
+/** Objects with at least this items count get a hash index of keys. */
+#define JFES_OBJECT_INDEX_THRESHOLD     16
+
+/** Strings with at least this bytes count left are scanned with vectors. */
+#define JFES_STRING_SCAN_BYTES          16
+
 /** Integer types */
 typedef enum jfes_integer_type {
     jfes_not_integer                = 0x00,     /**< String can't be interpreted as integer. */
@@ -88,6 +126,73 @@ static int jfes_check_configuration(const jfes_config_t *config) {
     return config && config->jfes_malloc && config->jfes_free;
 }
 
+/**
+    Adds a new block to the arena.
+
+    \param[in]      config              JFES configuration.
+    \param[in]      size                Minimal bytes count in the block.
+
+    \return         New block. JFES_NULL if no memory.
+*/
+static jfes_arena_block_t *jfes_arena_grow(const jfes_config_t *config, jfes_size_t size) {
+    jfes_arena_t *arena = config->arena;
+    if (size < arena->block_size) {
+        size = arena->block_size;
+    }
+
+    jfes_arena_block_t *block = (jfes_arena_block_t*)config->jfes_malloc(JFES_ARENA_HEADER_SIZE + size);
+    if (!block) {
+        return JFES_NULL;
+    }
+
+    block->size = size;
+    block->used = 0;
+    block->next = arena->blocks;
+    arena->blocks = block;
+    return block;
+}
+
+/**
+    Allocates memory for the values. Uses the arena if there is one.
+
+    \param[in]      config              JFES configuration.
+    \param[in]      size                Bytes count.
+
+    \return         Allocated memory. JFES_NULL if no memory.
+*/
+static void *jfes_allocate(const jfes_config_t *config, jfes_size_t size) {
+    jfes_arena_t *arena = config->arena;
+    if (!arena) {
+        return config->jfes_malloc(size);
+    }
+
+    size = (size + JFES_ARENA_ALIGNMENT - 1) & ~(JFES_ARENA_ALIGNMENT - 1);
+
+    jfes_arena_block_t *block = arena->blocks;
+    if (!block || block->size - block->used < size) {
+        block = jfes_arena_grow(config, size);
+        if (!block) {
+            return JFES_NULL;
+        }
+    }
+
+    void *result = (char*)block + JFES_ARENA_HEADER_SIZE + block->used;
+    block->used += size;
+    return result;
+}
+
+/**
+    Deallocates memory of the values. Arena memory is freed only by jfes_release_arena().
+
+    \param[in]      config              JFES configuration.
+    \param[in]      data                Memory to free.
+*/
+static void jfes_deallocate(const jfes_config_t *config, void *data) {
+    if (!config->arena) {
+        config->jfes_free(data);
+    }
+}
+
 /**
     Allocates jfes_string.
 
@@ -104,7 +209,8 @@ static jfes_status_t jfes_allocate_string(const jfes_config_t *config, jfes_stri
 
     jfes_status_t status = jfes_success;
 
-    str->data = (char*)config->jfes_malloc(size);
+    str->view = 0;
+    str->data = (char*)jfes_allocate(config, size);
     if (!str->data) {
         status = jfes_no_memory;
         size = 0;
@@ -130,7 +236,9 @@ static jfes_status_t jfes_free_string(const jfes_config_t *config, jfes_string_t
 
     if (str->size > 0) {
         str->size = 0;
-        config->jfes_free(str->data);
+        if (!str->view) {
+            jfes_deallocate(config, str->data);
+        }
         str->data = JFES_NULL;
     }
 
@@ -151,6 +259,7 @@ static jfes_status_t jfes_create_string(const jfes_config_t *config, jfes_string
     if (!jfes_check_configuration(config) || !str || !string || size == 0) {
         str->data = 0;
         str->size = 0;
+        str->view = 0;
         return jfes_invalid_arguments;
     }
 
@@ -163,6 +272,30 @@ static jfes_status_t jfes_create_string(const jfes_config_t *config, jfes_string
     return status;
 }
 
+/**
+    Creates string object pointing into the JSON string. Terminates it in place.
+
+    \param[out]     str                 String to be created.
+    \param[in,out]  string              String start in the JSON string.
+    \param[in]      size                String length.
+
+    \return         jfes_success if everything is OK.
+*/
+static jfes_status_t jfes_create_string_view(jfes_string_t *str, char *string, jfes_size_t size) {
+    if (!str || !string || size == 0) {
+        str->data = 0;
+        str->size = 0;
+        str->view = 0;
+        return jfes_invalid_arguments;
+    }
+
+    string[size] = '\0';
+    str->data = string;
+    str->size = size + 1;
+    str->view = 1;
+    return jfes_success;
+}
+
 /**
     Finds length of the null-terminated string.
 
@@ -852,6 +985,145 @@ static jfes_status_t jfes_parse_primitive(jfes_parser_t *parser, const char *jso
     return jfes_success;
 }
 
+#if defined(JFES_SIMD_SSE2)
+/**
+    Finds the lowest set bit.
+
+    \param[in]      mask                Nonzero bit mask.
+
+    \return         Index of the lowest set bit.
+*/
+static jfes_size_t jfes_lowest_bit(unsigned int mask) {
+#ifdef _MSC_VER
+    unsigned long index;
+    _BitScanForward(&index, mask);
+    return (jfes_size_t)index;
+#else
+    return (jfes_size_t)__builtin_ctz(mask);
+#endif
+}
+
+/**
+    Skips string bytes 16 at a time with SSE2.
+
+    \param[in]      json                JSON data string.
+    \param[in]      pos                 Position to start from.
+    \param[in]      length              JSON data length.
+
+    \return         Position of the first quote, backslash or terminator,
+                    or a position less than 16 bytes before the end.
+*/
+static jfes_size_t jfes_skip_string_sse2(const char *json, jfes_size_t pos, jfes_size_t length) {
+    const __m128i quote = _mm_set1_epi8('\"');
+    const __m128i backslash = _mm_set1_epi8('\\');
+    const __m128i terminator = _mm_setzero_si128();
+
+    for (; pos + 16 <= length; pos += 16) {
+        __m128i bytes = _mm_loadu_si128((const __m128i*)(json + pos));
+        __m128i special = _mm_or_si128(_mm_or_si128(_mm_cmpeq_epi8(bytes, quote),
+            _mm_cmpeq_epi8(bytes, backslash)), _mm_cmpeq_epi8(bytes, terminator));
+
+        unsigned int mask = (unsigned int)_mm_movemask_epi8(special);
+        if (mask) {
+            return pos + jfes_lowest_bit(mask);
+        }
+    }
+
+    return pos;
+}
+#endif
+
+#if defined(JFES_SIMD_AVX2)
+/**
+    Skips string bytes 32 at a time with AVX2. Only called if the CPU supports it.
+
+    \param[in]      json                JSON data string.
+    \param[in]      pos                 Position to start from.
+    \param[in]      length              JSON data length.
+
+    \return         Position of the first quote, backslash or terminator,
+                    or a position less than 32 bytes before the end.
+*/
+__attribute__((target("avx2")))
+static jfes_size_t jfes_skip_string_avx2(const char *json, jfes_size_t pos, jfes_size_t length) {
+    const __m256i quote = _mm256_set1_epi8('\"');
+    const __m256i backslash = _mm256_set1_epi8('\\');
+    const __m256i terminator = _mm256_setzero_si256();
+
+    for (; pos + 32 <= length; pos += 32) {
+        __m256i bytes = _mm256_loadu_si256((const __m256i*)(json + pos));
+        __m256i special = _mm256_or_si256(_mm256_or_si256(_mm256_cmpeq_epi8(bytes, quote),
+            _mm256_cmpeq_epi8(bytes, backslash)), _mm256_cmpeq_epi8(bytes, terminator));
+
+        unsigned int mask = (unsigned int)_mm256_movemask_epi8(special);
+        if (mask) {
+            return pos + jfes_lowest_bit(mask);
+        }
+    }
+
+    return pos;
+}
+#endif
+
+#if defined(JFES_SIMD_NEON)
+/**
+    Skips string bytes 16 at a time with NEON.
+
+    \param[in]      json                JSON data string.
+    \param[in]      pos                 Position to start from.
+    \param[in]      length              JSON data length.
+
+    \return         Start of the first 16 bytes with a quote, backslash or terminator,
+                    or a position less than 16 bytes before the end.
+*/
+static jfes_size_t jfes_skip_string_neon(const char *json, jfes_size_t pos, jfes_size_t length) {
+    const uint8x16_t quote = vdupq_n_u8('\"');
+    const uint8x16_t backslash = vdupq_n_u8('\\');
+    const uint8x16_t terminator = vdupq_n_u8(0);
+
+    for (; pos + 16 <= length; pos += 16) {
+        uint8x16_t bytes = vld1q_u8((const uint8_t*)(json + pos));
+        uint8x16_t special = vorrq_u8(vorrq_u8(vceqq_u8(bytes, quote),
+            vceqq_u8(bytes, backslash)), vceqq_u8(bytes, terminator));
+
+        if (vmaxvq_u8(special)) {
+            break;
+        }
+    }
+
+    return pos;
+}
+#endif
+
+/**
+    Skips string bytes which need no checks with the best vector instructions available.
+    The scalar loop in jfes_parse_string() goes on from the returned position.
+
+    \param[in]      json                JSON data string.
+    \param[in]      pos                 Position to start from.
+    \param[in]      length              JSON data length.
+
+    \return         Position to go on from. Not greater than the position of the first
+                    quote, backslash or terminator.
+*/
+static jfes_size_t jfes_skip_string_bytes(const char *json, jfes_size_t pos, jfes_size_t length) {
+#if defined(JFES_SIMD_AVX2)
+    if (__builtin_cpu_supports("avx2")) {
+        pos = jfes_skip_string_avx2(json, pos, length);
+    }
+#endif
+
+#if defined(JFES_SIMD_SSE2)
+    return jfes_skip_string_sse2(json, pos, length);
+#elif defined(JFES_SIMD_NEON)
+    return jfes_skip_string_neon(json, pos, length);
+#else
+    (void)json;
+    (void)length;
+    return pos;
+#endif
+}
+
 /**
     Fills next available token with JSON string.
 
@@ -869,16 +1141,24 @@ static jfes_status_t jfes_parse_string(jfes_parser_t *parser, const char *json,
         return jfes_invalid_arguments;
     }
 
+    /* The token is taken before the scan, so a full pool is reported before a long string is read. */
+    jfes_token_t *token = jfes_allocate_token(parser, tokens, max_tokens_count);
+    if (!token) {
+        return jfes_no_memory;
+    }
+
     jfes_size_t start = parser->pos++;
-    while (parser->pos < length && json[parser->pos] != '\0') {
+    for (;;) {
+        if (parser->pos + JFES_STRING_SCAN_BYTES <= length) {
+            parser->pos = jfes_skip_string_bytes(json, parser->pos, length);
+        }
+
+        if (parser->pos >= length || json[parser->pos] == '\0') {
+            break;
+        }
+
         char c = json[parser->pos];
         if (c == '\"') {
-            jfes_token_t *token = jfes_allocate_token(parser, tokens, max_tokens_count);
-            if (!token) {
-                parser->pos = start;
-                return jfes_no_memory;
-            }
-
             jfes_fill_token(token, jfes_type_string, start + 1, parser->pos);
             return jfes_success;
         }
@@ -897,6 +1177,7 @@ static jfes_status_t jfes_parse_string(jfes_parser_t *parser, const char *json,
                         (symbol < (int)'A' || symbol > (int)'F') &&
                         (symbol < (int)'a' || symbol > (int)'f')) {
                         parser->pos = start;
+                        parser->next_token--;
                         return jfes_invalid_input;
                     }
                 }
@@ -904,6 +1185,7 @@ static jfes_status_t jfes_parse_string(jfes_parser_t *parser, const char *json,
                 break;
             default:
                 parser->pos = start;
+                parser->next_token--;
                 return jfes_invalid_input;
             }
         }
@@ -911,6 +1193,7 @@ static jfes_status_t jfes_parse_string(jfes_parser_t *parser, const char *json,
     }
 
     parser->pos = start;
+    parser->next_token--;
     return jfes_error_part;
 }
 
@@ -944,14 +1227,21 @@ jfes_status_t jfes_reset_parser(jfes_parser_t *parser) {
     return jfes_success;
 }
 
-jfes_status_t jfes_parse_tokens(jfes_parser_t *parser, const char *json,
-        jfes_size_t length, jfes_token_t *tokens, jfes_size_t *max_tokens_count) {
-    if (!parser || !json || length == 0 || !tokens || !max_tokens_count || *max_tokens_count == 0) {
-        return jfes_invalid_arguments;
-    }
+/**
+    Continues parsing from the current parser state. On jfes_no_memory the parser is left at
+    the token that did not fit, so parsing can be resumed with a larger copy of the tokens array.
 
-    jfes_reset_parser(parser);
+    \param[in, out] parser              Pointer to the jfes_parser_t object.
+    \param[in]      json                JSON data string.
+    \param[in]      length              JSON data length.
+    \param[in, out] tokens              Tokens array to fill.
+    \param[in, out] max_tokens_count    Maximal count of tokens in tokens array.
+                                        Will contain tokens count.
 
+    \return         jfes_success if everything is OK.
+*/
+static jfes_status_t jfes_resume_parse_tokens(jfes_parser_t *parser, const char *json,
+        jfes_size_t length, jfes_token_t *tokens, jfes_size_t *max_tokens_count) {
     jfes_token_t *token = JFES_NULL;
 
     jfes_size_t count = parser->next_token;
@@ -1084,6 +1374,114 @@ jfes_status_t jfes_parse_tokens(jfes_parser_t *parser, const char *json,
     return jfes_success;
 }
 
+jfes_status_t jfes_parse_tokens(jfes_parser_t *parser, const char *json,
+        jfes_size_t length, jfes_token_t *tokens, jfes_size_t *max_tokens_count) {
+    if (!parser || !json || length == 0 || !tokens || !max_tokens_count || *max_tokens_count == 0) {
+        return jfes_invalid_arguments;
+    }
+
+    jfes_reset_parser(parser);
+
+    return jfes_resume_parse_tokens(parser, json, length, tokens, max_tokens_count);
+}
+
+/**
+    Compares the object item key with the key.
+
+    \param[in]      item                Object item.
+    \param[in]      key                 Key to compare.
+    \param[in]      key_length          Key length.
+
+    \return         Zero if keys are not equal. Anything otherwise.
+*/
+static int jfes_key_equals(const jfes_object_map_t *item, const char *key, jfes_size_t key_length) {
+    return item && (item->key.size - 1) == key_length &&
+        jfes_memcmp(item->key.data, key, key_length) == 0;
+}
+
+/**
+    Calculates FNV-1a hash of the key.
+
+    \param[in]      key                 Key to hash.
+    \param[in]      key_length          Key length.
+
+    \return         Key hash.
+*/
+static jfes_size_t jfes_hash_key(const char *key, jfes_size_t key_length) {
+    unsigned int hash = 2166136261u;
+    for (jfes_size_t i = 0; i < key_length; i++) {
+        hash = (hash ^ (unsigned char)key[i]) * 16777619u;
+    }
+    return hash;
+}
+
+/**
+    Adds the object item to the hash index. The first item with the same key stays in the index.
+
+    \param[in]      object              Indexed object.
+    \param[in]      item_index          Item number.
+*/
+static void jfes_index_item(jfes_object_t *object, jfes_size_t item_index) {
+    jfes_object_map_t *item = object->items[item_index];
+    if (!item || item->key.size == 0) {
+        return;
+    }
+
+    jfes_size_t key_length = item->key.size - 1;
+    jfes_size_t mask = object->index_size - 1;
+    jfes_size_t slot = jfes_hash_key(item->key.data, key_length) & mask;
+    while (object->index[slot]) {
+        if (jfes_key_equals(object->items[object->index[slot] - 1], item->key.data, key_length)) {
+            return;
+        }
+        slot = (slot + 1) & mask;
+    }
+
+    object->index[slot] = item_index + 1;
+}
+
+/**
+    Rebuilds the hash index of the object. Small objects are not indexed.
+    Lookups fall back to the linear search if there is no index.
+
+    \param[in]      config              JFES configuration.
+    \param[in]      object              Object to index.
+
+    \return         jfes_success if everything is OK.
+*/
+static jfes_status_t jfes_index_object(const jfes_config_t *config, jfes_object_t *object) {
+    if (object->index) {
+        jfes_deallocate(config, object->index);
+        object->index = JFES_NULL;
+        object->index_size = 0;
+    }
+
+    if (object->count < JFES_OBJECT_INDEX_THRESHOLD) {
+        return jfes_success;
+    }
+
+    jfes_size_t index_size = JFES_OBJECT_INDEX_THRESHOLD;
+    while (index_size < object->count * 2) {
+        index_size *= 2;
+    }
+
+    object->index = (jfes_size_t*)jfes_allocate(config, index_size * sizeof(jfes_size_t));
+    if (!object->index) {
+        return jfes_no_memory;
+    }
+
+    object->index_size = index_size;
+    for (jfes_size_t i = 0; i < index_size; i++) {
+        object->index[i] = 0;
+    }
+
+    for (jfes_size_t i = 0; i < object->count; i++) {
+        jfes_index_item(object, i);
+    }
+
+    return jfes_success;
+}
+
 /**
     Creates jfes value node from the tokens sequence.
 
@@ -1101,8 +1499,7 @@ jfes_status_t jfes_create_node(jfes_tokens_data_t *tokens_data, jfes_value_t *va
         return jfes_invalid_arguments;
     }
 
-    jfes_malloc_t jfes_malloc = tokens_data->config->jfes_malloc;
-    jfes_free_t   jfes_free   = tokens_data->config->jfes_free;
+    const jfes_config_t *config = tokens_data->config;
 
     jfes_token_t *token = &tokens_data->tokens[tokens_data->current_token];
     tokens_data->current_token++;
@@ -1129,29 +1526,35 @@ jfes_status_t jfes_create_node(jfes_tokens_data_t *tokens_data, jfes_value_t *va
         break;
 
     case jfes_type_string:
-        jfes_create_string(tokens_data->config, &value->data.string_val,
-            tokens_data->json_data + token->start, token->end - token->start);
+        if (tokens_data->in_place_data) {
+            jfes_create_string_view(&value->data.string_val,
+                tokens_data->in_place_data + token->start, token->end - token->start);
+        }
+        else {
+            jfes_create_string(tokens_data->config, &value->data.string_val,
+                tokens_data->json_data + token->start, token->end - token->start);
+        }
         break;
 
     case jfes_type_array:
-        value->data.array_val = (jfes_array_t*)jfes_malloc(sizeof(jfes_array_t));
+        value->data.array_val = (jfes_array_t*)jfes_allocate(config, sizeof(jfes_array_t));
         if (!value->data.array_val) {
             return jfes_no_memory;
         }
 
         value->data.array_val->count = token->size;
         if (token->size > 0) {
-            value->data.array_val->items = (jfes_value_t**)jfes_malloc(token->size * sizeof(jfes_value_t*));
+            value->data.array_val->items = (jfes_value_t**)jfes_allocate(config, token->size * sizeof(jfes_value_t*));
             if (!value->data.array_val->items) {
-                jfes_free(value->data.array_val);
+                jfes_deallocate(config, value->data.array_val);
                 return jfes_no_memory;
             }
 
             for (jfes_size_t i = 0; i < token->size; i++) {
-                jfes_value_t *item = (jfes_value_t*)jfes_malloc(sizeof(jfes_value_t));
+                jfes_value_t *item = (jfes_value_t*)jfes_allocate(config, sizeof(jfes_value_t));
                 if (!item) {
-                    jfes_free(value->data.array_val->items);
-                    jfes_free(value->data.array_val);
+                    jfes_deallocate(config, value->data.array_val->items);
+                    jfes_deallocate(config, value->data.array_val);
                     return jfes_no_memory;
                 }
                 value->data.array_val->items[i] = item;
@@ -1168,24 +1571,29 @@ jfes_status_t jfes_create_node(jfes_tokens_data_t *tokens_data, jfes_value_t *va
         break;
 
     case jfes_type_object:
-        value->data.object_val = (jfes_object_t*)jfes_malloc(sizeof(jfes_object_t));
+        value->data.object_val = (jfes_object_t*)jfes_allocate(config, sizeof(jfes_object_t));
         if (!value->data.object_val) {
             return jfes_no_memory;
         }
 
+        value->data.object_val->count = 0;
+        value->data.object_val->items = JFES_NULL;
+        value->data.object_val->index = JFES_NULL;
+        value->data.object_val->index_size = 0;
+
         if (token->size > 0) {
             value->data.object_val->count = token->size;
-            value->data.object_val->items = (jfes_object_map_t**)jfes_malloc(token->size * sizeof(jfes_object_map_t*));
+            value->data.object_val->items = (jfes_object_map_t**)jfes_allocate(config, token->size * sizeof(jfes_object_map_t*));
             if (!value->data.object_val->items) {
-                jfes_free(value->data.object_val);
+                jfes_deallocate(config, value->data.object_val);
                 return jfes_no_memory;
             }
 
             for (jfes_size_t i = 0; i < token->size; i++) {
-                jfes_object_map_t *item = (jfes_object_map_t*)jfes_malloc(sizeof(jfes_object_map_t));
+                jfes_object_map_t *item = (jfes_object_map_t*)jfes_allocate(config, sizeof(jfes_object_map_t));
                 if (!item) {
-                    jfes_free(value->data.object_val->items);
-                    jfes_free(value->data.object_val);
+                    jfes_deallocate(config, value->data.object_val->items);
+                    jfes_deallocate(config, value->data.object_val);
                     return jfes_no_memory;
                 }
                 value->data.object_val->items[i] = item;
@@ -1194,10 +1602,15 @@ jfes_status_t jfes_create_node(jfes_tokens_data_t *tokens_data, jfes_value_t *va
 
                 jfes_size_t key_length = key_token->end - key_token->start;
 
-                jfes_create_string(tokens_data->config, &item->key,
-                    tokens_data->json_data + key_token->start, key_length);
+                if (tokens_data->in_place_data) {
+                    jfes_create_string_view(&item->key, tokens_data->in_place_data + key_token->start, key_length);
+                }
+                else {
+                    jfes_create_string(tokens_data->config, &item->key,
+                        tokens_data->json_data + key_token->start, key_length);
+                }
 
-                item->value = (jfes_value_t*)jfes_malloc(sizeof(jfes_value_t));
+                item->value = (jfes_value_t*)jfes_allocate(config, sizeof(jfes_value_t));
 
                 jfes_status_t status = jfes_create_node(tokens_data, item->value);
                 if (jfes_status_is_bad(status)) {
@@ -1207,6 +1620,8 @@ jfes_status_t jfes_create_node(jfes_tokens_data_t *tokens_data, jfes_value_t *va
                     return status;
                 }
             }
+
+            jfes_index_object(config, value->data.object_val);
         }
         break;
 
@@ -1216,7 +1631,18 @@ jfes_status_t jfes_create_node(jfes_tokens_data_t *tokens_data, jfes_value_t *va
     return jfes_success;
 }
 
-jfes_status_t jfes_parse_to_value(const jfes_config_t *config, const char *json,
+/**
+    Runs JSON parser and fills jfes_value_t object.
+
+    \param[in]      config              JFES configuration.
+    \param[in]      json                JSON data string.
+    \param[in]      in_place_data       The same JSON data string to keep strings in. JFES_NULL to copy strings.
+    \param[in]      length              JSON data length.
+    \param[out]     value               Output value.
+
+    \return         jfes_success if everything is OK.
+*/
+static jfes_status_t jfes_parse_to_node(const jfes_config_t *config, const char *json, char *in_place_data,
         jfes_size_t length, jfes_value_t *value) {
     if (!jfes_check_configuration(config) || !json || length == 0 || !value) {
         return jfes_invalid_arguments;
@@ -1229,29 +1655,37 @@ jfes_status_t jfes_parse_to_value(const jfes_config_t *config, const char *json,
     }
 
     jfes_size_t tokens_count = 1024;
-    jfes_token_t *tokens = JFES_NULL;
-
-    status = jfes_no_memory;
-    while (status == jfes_no_memory && tokens_count <= JFES_MAX_TOKENS_COUNT) {
-        jfes_reset_parser(&parser);
-
-        tokens = (jfes_token_t*)parser.config->jfes_malloc(tokens_count * sizeof(jfes_token_t));
-        if (!tokens) {
-            return jfes_no_memory;
-        }
+    jfes_token_t *tokens = (jfes_token_t*)parser.config->jfes_malloc(tokens_count * sizeof(jfes_token_t));
+    if (!tokens) {
+        return jfes_no_memory;
+    }
 
+    /* The tokens array grows and parsing resumes where it stopped, the input is scanned once. */
+    for (;;) {
         jfes_size_t current_tokens_count = tokens_count;
-        status = jfes_parse_tokens(&parser, json, length, tokens, &current_tokens_count);
+        status = jfes_resume_parse_tokens(&parser, json, length, tokens, &current_tokens_count);
         if (jfes_status_is_good(status)) {
             tokens_count = current_tokens_count;
             break;
         }
 
-        tokens_count *= 2;
+        if (status != jfes_no_memory || tokens_count * 2 > JFES_MAX_TOKENS_COUNT) {
+            break;
+        }
+
+        jfes_token_t *grown = (jfes_token_t*)parser.config->jfes_malloc(tokens_count * 2 * sizeof(jfes_token_t));
+        if (!grown) {
+            break;
+        }
+
+        jfes_memcpy(grown, tokens, parser.next_token * sizeof(jfes_token_t));
         parser.config->jfes_free(tokens);
+        tokens = grown;
+        tokens_count *= 2;
     }
 
     if (jfes_status_is_bad(status)) {
+        parser.config->jfes_free(tokens);
         return status;
     }
 
@@ -1260,68 +1694,123 @@ jfes_status_t jfes_parse_to_value(const jfes_config_t *config, const char *json,
 
     tokens_data.json_data = json;
     tokens_data.json_data_length = length;
+    tokens_data.in_place_data = in_place_data;
 
     tokens_data.tokens = tokens;
     tokens_data.tokens_count = tokens_count;
     tokens_data.current_token = 0;
 
+    if (config->arena) {
+        /* Every token makes at most a value, a key mapping and an item pointer, so the whole tree fits one block. */
+        jfes_size_t size = (in_place_data ? 0 : length) + tokens_count * (sizeof(jfes_value_t) + sizeof(jfes_object_map_t) + sizeof(void*) + 3 * JFES_ARENA_ALIGNMENT);
+        jfes_arena_block_t *block = config->arena->blocks;
+        if (!block || block->size - block->used < size) {
+            jfes_arena_grow(config, size);
+        }
+    }
+
     status = jfes_create_node(&tokens_data, value); /* what if no success here? */
 
     parser.config->jfes_free(tokens);
     return jfes_success;
 }
 
+jfes_status_t jfes_parse_to_value(const jfes_config_t *config, const char *json,
+        jfes_size_t length, jfes_value_t *value) {
+    return jfes_parse_to_node(config, json, JFES_NULL, length, value);
+}
+
+jfes_status_t jfes_parse_in_place(const jfes_config_t *config, char *json,
+        jfes_size_t length, jfes_value_t *value) {
+    return jfes_parse_to_node(config, json, json, length, value);
+}
+
 jfes_status_t jfes_free_value(const jfes_config_t *config, jfes_value_t *value) {
     if (!jfes_check_configuration(config) || !value) {
         return jfes_invalid_arguments;
     }
 
+    if (config->arena) {
+        return jfes_success;
+    }
+
     if (value->type == jfes_type_array) {
         if (value->data.array_val && value->data.array_val->count > 0) {
             for (jfes_size_t i = 0; i < value->data.array_val->count; i++) {
                 jfes_value_t *item = value->data.array_val->items[i];
                 jfes_free_value(config, item);
-                config->jfes_free(item);
+                jfes_deallocate(config, item);
             }
 
-            config->jfes_free(value->data.array_val->items);
+            jfes_deallocate(config, value->data.array_val->items);
         }
 
-        config->jfes_free(value->data.array_val);
+        jfes_deallocate(config, value->data.array_val);
     }
     else if (value->type == jfes_type_object) {
         if (value->data.object_val && value->data.object_val->count > 0) {
             for (jfes_size_t i = 0; i < value->data.object_val->count; i++) {
                 jfes_object_map_t *object_map = value->data.object_val->items[i];
 
-                config->jfes_free(object_map->key.data);
+                if (!object_map->key.view) {
+                    jfes_deallocate(config, object_map->key.data);
+                }
 
                 jfes_free_value(config, object_map->value);
-                config->jfes_free(object_map->value);
+                jfes_deallocate(config, object_map->value);
 
-                config->jfes_free(object_map);
+                jfes_deallocate(config, object_map);
             }
 
-            config->jfes_free(value->data.object_val->items);
+            jfes_deallocate(config, value->data.object_val->items);
         }
 
-        config->jfes_free(value->data.object_val);
+        if (value->data.object_val) {
+            jfes_deallocate(config, value->data.object_val->index);
+        }
+        jfes_deallocate(config, value->data.object_val);
     }
     else if (value->type == jfes_type_string) {
-        if (value->data.string_val.size > 0) {
-            config->jfes_free(value->data.string_val.data);
+        if (value->data.string_val.size > 0 && !value->data.string_val.view) {
+            jfes_deallocate(config, value->data.string_val.data);
         }
     }
 
     return jfes_success;
 }
 
+jfes_status_t jfes_init_arena(jfes_arena_t *arena, jfes_size_t block_size) {
+    if (!arena) {
+        return jfes_invalid_arguments;
+    }
+
+    arena->blocks = JFES_NULL;
+    arena->block_size = block_size > 0 ? block_size : JFES_ARENA_BLOCK_SIZE;
+    return jfes_success;
+}
+
+jfes_status_t jfes_release_arena(const jfes_config_t *config) {
+    if (!jfes_check_configuration(config) || !config->arena) {
+        return jfes_invalid_arguments;
+    }
+
+    jfes_arena_block_t *block = config->arena->blocks;
+    while (block) {
+        jfes_arena_block_t *next = block->next;
+        config->jfes_free(block);
+        block = next;
+    }
+
+    config->arena->blocks = JFES_NULL;
+    return jfes_success;
+}
+
 jfes_value_t *jfes_create_null_value(const jfes_config_t *config) {
     if (!config) {
         return JFES_NULL;
     }
 
-    jfes_value_t *result = (jfes_value_t*)config->jfes_malloc(sizeof(jfes_value_t));
+    jfes_value_t *result = (jfes_value_t*)jfes_allocate(config, sizeof(jfes_value_t));
     if (!result) {
         return JFES_NULL;
     }
@@ -1335,7 +1824,7 @@ jfes_value_t *jfes_create_boolean_value(const jfes_config_t *config, int value)
         return JFES_NULL;
     }
 
-    jfes_value_t *result = (jfes_value_t*)config->jfes_malloc(sizeof(jfes_value_t));
+    jfes_value_t *result = (jfes_value_t*)jfes_allocate(config, sizeof(jfes_value_t));
     if (!result) {
         return JFES_NULL;
     }
@@ -1350,7 +1839,7 @@ jfes_value_t *jfes_create_integer_value(const jfes_config_t *config, int value)
         return JFES_NULL;
     }
 
-    jfes_value_t *result = (jfes_value_t*)config->jfes_malloc(sizeof(jfes_value_t));
+    jfes_value_t *result = (jfes_value_t*)jfes_allocate(config, sizeof(jfes_value_t));
     if (!result) {
         return JFES_NULL;
     }
@@ -1365,7 +1854,7 @@ jfes_value_t *jfes_create_double_value(const jfes_config_t *config, double value
         return JFES_NULL;
     }
 
-    jfes_value_t *result = (jfes_value_t*)config->jfes_malloc(sizeof(jfes_value_t));
+    jfes_value_t *result = (jfes_value_t*)jfes_allocate(config, sizeof(jfes_value_t));
     if (!result) {
         return JFES_NULL;
     }
@@ -1384,7 +1873,7 @@ jfes_value_t *jfes_create_string_value(const jfes_config_t *config, const char *
         length = jfes_strlen(value);
     }
 
-    jfes_value_t *result = (jfes_value_t*)config->jfes_malloc(sizeof(jfes_value_t));
+    jfes_value_t *result = (jfes_value_t*)jfes_allocate(config, sizeof(jfes_value_t));
     if (!result) {
         return JFES_NULL;
     }
@@ -1392,7 +1881,7 @@ jfes_value_t *jfes_create_string_value(const jfes_config_t *config, const char *
 
     jfes_status_t status = jfes_create_string(config, &result->data.string_val, value, length);
     if (jfes_status_is_bad(status)) {
-        config->jfes_free(result);
+        jfes_deallocate(config, result);
         return JFES_NULL;
     }
 
@@ -1404,16 +1893,16 @@ jfes_value_t *jfes_create_array_value(const jfes_config_t *config) {
         return JFES_NULL;
     }
 
-    jfes_value_t *result = (jfes_value_t*)config->jfes_malloc(sizeof(jfes_value_t));
+    jfes_value_t *result = (jfes_value_t*)jfes_allocate(config, sizeof(jfes_value_t));
     if (!result) {
         return JFES_NULL;
     }
 
     result->type = jfes_type_array;
 
-    result->data.array_val = (jfes_array_t*)config->jfes_malloc(sizeof(jfes_array_t));
+    result->data.array_val = (jfes_array_t*)jfes_allocate(config, sizeof(jfes_array_t));
     if (!result->data.array_val) {
-        config->jfes_free(result);
+        jfes_deallocate(config, result);
         return JFES_NULL;
     }
     result->data.array_val->count = 0;
@@ -1427,19 +1916,21 @@ jfes_value_t *jfes_create_object_value(const jfes_config_t *config) {
         return JFES_NULL;
     }
 
-    jfes_value_t *result = (jfes_value_t*)config->jfes_malloc(sizeof(jfes_value_t));
+    jfes_value_t *result = (jfes_value_t*)jfes_allocate(config, sizeof(jfes_value_t));
     if (!result) {
         return JFES_NULL;
     }
     result->type = jfes_type_object;
 
-    result->data.object_val = (jfes_object_t*)config->jfes_malloc(sizeof(jfes_object_t));
+    result->data.object_val = (jfes_object_t*)jfes_allocate(config, sizeof(jfes_object_t));
     if (!result->data.object_val) {
-        config->jfes_free(result);
+        jfes_deallocate(config, result);
         return JFES_NULL;
     }
     result->data.object_val->count = 0;
     result->data.object_val->items = JFES_NULL;
+    result->data.object_val->index = JFES_NULL;
+    result->data.object_val->index_size = 0;
 
     return result;
 }
@@ -1462,10 +1953,22 @@ jfes_object_map_t *jfes_get_mapped_child(const jfes_value_t *value, const char *
         key_length = jfes_strlen(key);
     }
 
-    for (jfes_size_t i = 0; i < value->data.object_val->count; i++) {
-        jfes_object_map_t *item = value->data.object_val->items[i];
-        if (item && (item->key.size - 1) == key_length &&
-                jfes_memcmp(item->key.data, key, key_length) == 0) {
+    jfes_object_t *object = value->data.object_val;
+    if (object->index) {
+        jfes_size_t mask = object->index_size - 1;
+        for (jfes_size_t slot = jfes_hash_key(key, key_length) & mask; object->index[slot]; slot = (slot + 1) & mask) {
+            jfes_object_map_t *item = object->items[object->index[slot] - 1];
+            if (jfes_key_equals(item, key, key_length)) {
+                return item;
+            }
+        }
+
+        return JFES_NULL;
+    }
+
+    for (jfes_size_t i = 0; i < object->count; i++) {
+        jfes_object_map_t *item = object->items[i];
+        if (jfes_key_equals(item, key, key_length)) {
             return item;
         }
     }
@@ -1490,7 +1993,7 @@ jfes_status_t jfes_place_to_array_at(const jfes_config_t *config, const jfes_val
         place_at = value->data.array_val->count;
     }
 
-    jfes_value_t **items_array = (jfes_value_t**)config->jfes_malloc((value->data.array_val->count + 1) * sizeof(jfes_value_t*));
+    jfes_value_t **items_array = (jfes_value_t**)jfes_allocate(config, (value->data.array_val->count + 1) * sizeof(jfes_value_t*));
     if (!items_array) {
         return jfes_no_memory;
     }
@@ -1507,7 +2010,7 @@ jfes_status_t jfes_place_to_array_at(const jfes_config_t *config, const jfes_val
 
     value->data.array_val->count++;
 
-    config->jfes_free(value->data.array_val->items);
+    jfes_deallocate(config, value->data.array_val->items);
     value->data.array_val->items = items_array;
     return jfes_success;
 }
@@ -1523,7 +2026,7 @@ jfes_status_t jfes_remove_from_array(const jfes_config_t *config, const jfes_val
 
     jfes_value_t *item = value->data.array_val->items[index];
     jfes_free_value(config, item);
-    config->jfes_free(item);
+    jfes_deallocate(config, item);
 
     for (jfes_size_t i = index; i < value->data.array_val->count - 1; i++) {
         value->data.array_val->items[i] = value->data.array_val->items[i + 1];
@@ -1546,10 +2049,10 @@ jfes_status_t jfes_set_object_property(const jfes_config_t *config, const jfes_v
     jfes_object_map_t *object_map = jfes_get_mapped_child(value, key, key_length);
     if (object_map) {
         jfes_free_value(config, object_map->value);
-        config->jfes_free(object_map->value);
+        jfes_deallocate(config, object_map->value);
     }
     else {
-        jfes_object_map_t **items_map = (jfes_object_map_t**)config->jfes_malloc((value->data.object_val->count + 1) * sizeof(jfes_object_map_t*));
+        jfes_object_map_t **items_map = (jfes_object_map_t**)jfes_allocate(config, (value->data.object_val->count + 1) * sizeof(jfes_object_map_t*));
         if (!items_map) {
             return jfes_no_memory;
         }
@@ -1558,23 +2061,32 @@ jfes_status_t jfes_set_object_property(const jfes_config_t *config, const jfes_v
             items_map[i] = value->data.object_val->items[i];
         }
 
-        items_map[value->data.object_val->count] = (jfes_object_map_t*)config->jfes_malloc(sizeof(jfes_object_map_t));
+        items_map[value->data.object_val->count] = (jfes_object_map_t*)jfes_allocate(config, sizeof(jfes_object_map_t));
         if (!items_map[value->data.object_val->count]) {
-            config->jfes_free(items_map);
+            jfes_deallocate(config, items_map);
             return jfes_no_memory;
         }
         object_map = items_map[value->data.object_val->count];
 
         jfes_status_t status = jfes_create_string(config, &object_map->key, key, key_length);
         if (jfes_status_is_bad(status)) {
-            config->jfes_free(items_map);
+            jfes_deallocate(config, items_map);
             return status;
         }
 
-        config->jfes_free(value->data.object_val->items);
+        jfes_deallocate(config, value->data.object_val->items);
 
         value->data.object_val->items = items_map;
         value->data.object_val->count++;
+
+        /* The index grows twice when it is half full, so adding keys one by one stays linear. */
+        jfes_object_t *object = value->data.object_val;
+        if (object->index && object->count * 2 <= object->index_size) {
+            jfes_index_item(object, object->count - 1);
+        }
+        else {
+            jfes_index_object(config, object);
+        }
     }
 
     object_map->value = item;
@@ -1597,7 +2109,7 @@ jfes_status_t jfes_remove_object_property(const jfes_config_t *config, const jfe
     }
 
     jfes_free_value(config, mapped_item->value);
-    config->jfes_free(mapped_item->value);
+    jfes_deallocate(config, mapped_item->value);
 
     jfes_free_string(config, &mapped_item->key);
 
@@ -1605,7 +2117,7 @@ jfes_status_t jfes_remove_object_property(const jfes_config_t *config, const jfe
     for (i = 0; i < value->data.object_val->count; i++) {
         jfes_object_map_t *item = value->data.object_val->items[i];
         if (item == mapped_item) {
-            config->jfes_free(item);
+            jfes_deallocate(config, item);
             mapped_item = JFES_NULL;
             break;
         }
@@ -1620,6 +2132,7 @@ jfes_status_t jfes_remove_object_property(const jfes_config_t *config, const jfe
 
     value->data.object_val->count--;
 
+    jfes_index_object(config, value->data.object_val);
     return jfes_success;
 }
 
@@ -46,6 +46,7 @@ typedef void (*jfes_free_t)(void*);
 typedef struct jfes_string {
     char            *data;                      /**< String bytes. */
     jfes_size_t     size;                       /**< Allocated bytes count. */
+    int             view;                       /**< Nonzero if data points into the parsed JSON string and is not owned. */
 } jfes_string_t;
 
 /** JFES token types */
@@ -75,10 +76,20 @@ typedef struct jfes_token {
     jfes_size_t             size;               /**< Token children count. */
 } jfes_token_t;
 
-/** JFES config structure. */
+/** JFES arena block, allocated with jfes_malloc. */
+typedef struct jfes_arena_block jfes_arena_block_t;
+
+/** JFES arena structure. Values are bump allocated from a few large blocks. */
+typedef struct jfes_arena {
+    jfes_arena_block_t      *blocks;            /**< Blocks list, the current block goes first. */
+    jfes_size_t             block_size;         /**< Minimal size of a new block. */
+} jfes_arena_t;
+
+/** JFES config structure. Zero-initialize it, so optional fields like arena read as unset. */
 typedef struct jfes_config {
     jfes_malloc_t           jfes_malloc;        /**< Memory allocation function. */
     jfes_free_t             jfes_free;          /**< Memory deallocation function. */
+    jfes_arena_t            *arena;             /**< Optional arena for values. JFES_NULL to use jfes_malloc directly. */
 } jfes_config_t;
 
 /** JFES tokens data structure. */
@@ -87,6 +98,7 @@ typedef struct jfes_tokens_data {
 
     const char              *json_data;         /**< JSON string. */
     jfes_size_t             json_data_length;   /**< JSON string length. */
+    char                    *in_place_data;     /**< JSON string to keep strings in. JFES_NULL to copy strings. */
 
     jfes_token_t            *tokens;            /**< String parsing result in tokens. */
     jfes_size_t             tokens_count;       /**< Tokens count. */
@@ -122,6 +134,9 @@ typedef struct jfes_array {
 typedef struct jfes_object {
     jfes_object_map_t       **items;            /**< JSON items in object. */
     jfes_size_t             count;              /**< Items count in object. */
+
+    jfes_size_t             *index;             /**< Hash index of items (item number + 1, zero for free slot). JFES_NULL for small objects. */
+    jfes_size_t             index_size;         /**< Index slots count, a power of two. */
 } jfes_object_t;
 
 /** JFES value data union. */
@@ -208,8 +223,44 @@ jfes_status_t jfes_parse_tokens(jfes_parser_t *parser, const char *json,
 jfes_status_t jfes_parse_to_value(const jfes_config_t *config, const char *json,
     jfes_size_t length, jfes_value_t *value);
 
+/**
+    Runs JSON parser and fills jfes_value_t object without copying strings.
+    Strings and keys of the value are views into the json: their closing quotes
+    are replaced with terminators, so json must outlive the value. Strings are
+    not unescaped, this can be done in place as the result is never longer.
+
+    \param[in]      config              JFES configuration.
+    \param[in,out]  json                JSON data string.
+    \param[in]      length              JSON data length.
+    \param[out]     value               Output value.
+
+    \return         jfes_success if everything is OK.
+*/
+jfes_status_t jfes_parse_in_place(const jfes_config_t *config, char *json,
+    jfes_size_t length, jfes_value_t *value);
+
+/**
+    JFES arena initialization.
+
+    \param[out]     arena               Pointer to the jfes_arena_t object.
+    \param[in]      block_size          Minimal block size. Zero for default.
+
+    \return         jfes_success if everything is OK.
+*/
+jfes_status_t jfes_init_arena(jfes_arena_t *arena, jfes_size_t block_size);
+
+/**
+    Frees all blocks of the configuration arena and all values allocated there.
+
+    \param[in]      config              JFES configuration.
+
+    \return         jfes_success if everything is OK.
+*/
+jfes_status_t jfes_release_arena(const jfes_config_t *config);
+
 /**
     Frees all resources captured by the object.
+    Does nothing if the configuration has an arena, see jfes_release_arena().
 
     \param[in]      config              JFES configuration.
     \param[in,out]  value               Object to free.
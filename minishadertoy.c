@@ -1,754 +1,3426 @@
-#include <stdio.h>
-#include <stdlib.h>
-#include <string.h>
-#include <assert.h>
-#include <time.h>
-#include <sys/stat.h>
-#include <libgen.h>
-#include <unistd.h>
-#include <errno.h>
-#include "glad.h"
-#include "jfes/jfes.h"
-#include <GLFW/glfw3.h>
-#include "minishadertoy.h"
-#define STB_IMAGE_IMPLEMENTATION
-#include "stb_image.h"
-
-#ifndef __MINGW32__
-#define MKDIRARGS ,0777
-#else
-#define MKDIRARGS
-#endif
-
-static GLFWwindow *_mainWindow;
-
-static const char *shader_header = 
-    "#version 300 es\n"
-    "#extension GL_EXT_shader_texture_lod : enable\n"
-    "#extension GL_OES_standard_derivatives : enable\n"
-    "#define iGlobalTime iTime\n"
-    "precision highp float;\n"
-    "precision highp int;\n"
-    "precision highp sampler2D;\n"
-    "out vec4 fragmentColor;\n"
-    "uniform vec3      iResolution;\n"
-    "uniform float     iTime;\n"
-    "uniform float     iTimeDelta;\n"
-    "uniform int       iFrame;\n"
-    "uniform float     iChannelTime[4];\n"
-    "uniform vec3      iChannelResolution[4];\n"
-    "uniform vec4      iMouse;\n"
-    "uniform vec4      iDate;\n"
-    "uniform float     iSampleRate;\n"
-    "uniform sampler%s iChannel0;\n"
-    "uniform sampler%s iChannel1;\n"
-    "uniform sampler%s iChannel2;\n"
-    "uniform sampler%s iChannel3;\n";
-
-static const char *shader_footer = 
-    "\nvoid main(void) {\n"
-    "    vec4 color = vec4(0.0,0.0,0.0,1.0);\n"
-    "    mainImage(color, gl_FragCoord.xy);\n"
-    "    color.w = 1.0;\n"
-    "    fragmentColor = color;\n"
-    "}\n";
-
-#ifdef HAVE_CURL
-#include <curl/curl.h>
-
-struct buffer
-{
-    char *m_buffer;
-    int m_buf_size;
-};
-
-static size_t buffer_write_cb(void *ptr, size_t size, size_t nmemb, void *stream)
-{
-    struct buffer *b = (struct buffer *)stream;
-    int buf_pos = b->m_buf_size;
-    b->m_buf_size += size*nmemb;
-    b->m_buffer = realloc(b->m_buffer, b->m_buf_size);
-    memcpy(b->m_buffer + buf_pos, ptr, size*nmemb);
-    return size*nmemb;
-}
-
-static char *load_url(const char *url, int *size, int is_post)
-{
-    struct buffer b = { 0 };
-    CURL *curl;
-    CURLcode res;
-    curl = curl_easy_init();
-    if (!curl)
-        return 0;
-    if (is_post)
-    {
-        char buf[256];
-        char *id = strrchr(url, '/');
-        if (!id)
-            goto fail;
-        snprintf(buf, sizeof(buf), "s={ \"shaders\" : [\"%s\"] }", id + 1);
-        curl_easy_setopt(curl, CURLOPT_URL, "https://www.shadertoy.com/shadertoy");
-        curl_easy_setopt(curl, CURLOPT_POSTFIELDS, buf);
-        curl_easy_setopt(curl, CURLOPT_REFERER, "https://www.shadertoy.com/browse");
-    } else
-        curl_easy_setopt(curl, CURLOPT_URL, url);
-    curl_easy_setopt(curl, CURLOPT_WRITEFUNCTION, buffer_write_cb);
-    curl_easy_setopt(curl, CURLOPT_WRITEDATA, &b);
-    res = curl_easy_perform(curl);
-    if (res != CURLE_OK)
-    {
-        if (b.m_buffer)
-            free(b.m_buffer);
-        printf("curl_easy_perform() failed: %s\n", curl_easy_strerror(res));
-        return 0;
-    }
-fail:
-    curl_easy_cleanup(curl);
-    *size = b.m_buf_size;
-    //printf("%d readed\n", *size);
-    return b.m_buffer;
-}
-#endif
-
-static int mkpath(char *path)
-{
-    int len = (int)strlen(path);
-    if (len <= 0)
-        return 0;
-
-    char *buffer = (char*)malloc(len + 1);
-    if (!buffer)
-        goto fail;
-    strcpy(buffer, path);
-
-    if (buffer[len - 1] == '/')
-    {
-        buffer[len - 1] = '\0';
-        if (!mkdir(buffer MKDIRARGS))
-        {
-            free(buffer);
-            return 1;
-        }
-        buffer[len - 1] = '/';
-    }
-
-    char *p = buffer + 1;
-    while (1)
-    {
-        while (*p && *p != '\\' && *p != '/')
-            p++;
-        if (!*p)
-            break;
-        char sav = *p;
-        *p = 0;
-        if ((mkdir(buffer MKDIRARGS) == -1) && (errno == ENOENT))
-            goto fail;
-        *p++ = sav;
-    }
-    free(buffer);
-    return 1;
-fail:
-    printf("error: creating %s failed", path);
-    if (buffer)
-        free(buffer);
-    return 0;
-}
-
-static unsigned char *load_file(const char *fname, int *data_size)
-{
-    FILE *file = fopen(fname, "rb");
-    unsigned char *data;
-    *data_size = 0;
-    if (!file)
-        return 0;
-    fseek(file, 0, SEEK_END);
-    *data_size = (int)ftell(file);
-    fseek(file, 0, SEEK_SET);
-    data = (unsigned char*)malloc(*data_size + 1);
-    if (!data)
-        goto fail;
-    if ((int)fread(data, 1, *data_size, file) != *data_size)
-        exit(1);
-    data[*data_size] = 0;
-fail:
-    fclose(file);
-    return data;
-}
-
-static int codepoint_utf8(uint32_t codepoint, char **buf)
-{
-    int len = 0;
-    char *p = *buf;
-    if (codepoint >= 0x110000u)
-        return 0;
-    if (codepoint < 0x80u)
-    {
-        p[len++] = (char)codepoint;
-    } else if (codepoint < 0x800u)
-    {
-        p[len++] = (char)(0xC0 | codepoint >> 6 & 0x1F);
-        p[len++] = (char)(0x80 | codepoint & 0x3F);
-    } else if (codepoint < 0x10000u)
-    {
-        p[len++] = (char)(0xE0 | codepoint >> 12 & 0xF);
-        p[len++] = (char)(0x80 | codepoint >> 6 & 0x3F);
-        p[len++] = (char)(0x80 | codepoint & 0x3F);
-    } else
-    {
-        p[len++] = (char)(0xF0 | codepoint >> 18 & 0x7);
-        p[len++] = (char)(0x80 | codepoint >> 12 & 0x3F);
-        p[len++] = (char)(0x80 | codepoint >> 6 & 0x3F);
-        p[len++] = (char)(0x80 | codepoint & 0x3F);
-    }
-    return len;
-}
-
-static int unescape_json(char *buf, int buf_len, char *out_buf)
-{
-    enum {
-        JSON_INITIAL,
-        JSON_ESCAPE,
-        JSON_UNICODE,
-        JSON_UTF16_I1,
-        JSON_UTF16_I2,
-        JSON_UTF16_LS
-    };
-    int i, ubuf_offset, len = 0, state = JSON_INITIAL;
-    uint32_t u1, codepoint;
-    char ch, *p = out_buf, *pt;
-    char ubuf[5];
-    ubuf[4] = 0;
-    for (i = 0; i < buf_len; i++)
-    {
-        ch = buf[i];
-        if (state == JSON_INITIAL)
-        {
-            if (ch != '\\')
-                p[len++] = ch;
-            else
-                state = JSON_ESCAPE;
-        } else if (state == JSON_ESCAPE || state == JSON_UTF16_I2)
-        {
-            int old_state = state;
-            state = JSON_INITIAL;
-            switch(ch)
-            {
-                case 'n': p[len++] = '\n'; break;
-                case 't': p[len++] = '\t'; break;
-                case 'r': p[len++] = '\r'; break;
-                case 'b': p[len++] = '\b'; break;
-                case 'f': p[len++] = '\f'; break;
-                case 'u': state = (JSON_ESCAPE == old_state) ? JSON_UNICODE : JSON_UTF16_LS; ubuf_offset = 0; break;
-                default: p[len++] = ch; break;
-            }
-        } else if (state == JSON_UNICODE)
-        {
-            ubuf[ubuf_offset++] = ch;
-            if (ubuf_offset == 4)
-            {
-                codepoint = strtol(ubuf, NULL, 16);
-                if ((codepoint & 0xFC00u) == 0xD800u)
-                {
-                    u1 = codepoint;
-                    state = JSON_UTF16_I1;
-                } else
-                {
-                    pt = &p[len];
-                    len += codepoint_utf8(codepoint, &pt);
-                    state = JSON_INITIAL;
-                }
-            }
-        } else if (state == JSON_UTF16_I1)
-        {
-            if (ch != '\\')
-            {
-                p[len++] = ch;
-                state = JSON_INITIAL;
-            } else
-                state = JSON_UTF16_I2;
-        } else if (state == JSON_UTF16_LS)
-        {
-            ubuf[ubuf_offset++] = ch;
-            if (ubuf_offset == 4)
-            {
-                codepoint = strtol(ubuf, NULL, 16);
-                if ((codepoint & 0xFC00u) == 0xDC00u)
-                    codepoint = ((u1 & 0x3FFu) << 10 | codepoint & 0x3FFu) + 0x10000u;
-                pt = &p[len];
-                len += codepoint_utf8(codepoint, &pt);
-                state = JSON_INITIAL;
-            }
-        }
-    }
-    p[len] = 0;
-    return len;
-}
-
-void CheckGLErrors(const char *func, int line)
-{
-    int lasterror = glGetError();
-    if (lasterror)
-    {
-        printf("OpenGL error in %s, %i: err=%i\n", func, line, lasterror); fflush(stdout);
-    }
-}
-
-static void gl_init()
-{
-    if (!glfwInit())
-    {
-        printf("error: glfw init failed\n");
-        exit(1);
-    }
-#ifdef USE_GLES3
-    glfwWindowHint(GLFW_CONTEXT_VERSION_MAJOR, 3);
-    glfwWindowHint(GLFW_CONTEXT_VERSION_MINOR, 3);
-    glfwWindowHint(GLFW_OPENGL_PROFILE, GLFW_OPENGL_CORE_PROFILE);
-    glfwWindowHint(GLFW_OPENGL_FORWARD_COMPAT, GL_TRUE);
-#else
-    glfwWindowHint(GLFW_CONTEXT_VERSION_MAJOR, 2);
-    glfwWindowHint(GLFW_CONTEXT_VERSION_MINOR, 0);
-#endif
-    glfwWindowHint(GLFW_RESIZABLE, 1);
-    _mainWindow = glfwCreateWindow(600, 400, "Shadertoy", NULL, NULL);
-    if (!_mainWindow)
-    {
-        printf("error: create window failed\n"); fflush(stdout);
-        exit(1);
-    }
-    glfwMakeContextCurrent(_mainWindow);
-#ifdef USE_GLES3
-    glGenerateMipmap = (PFNGLGENERATEMIPMAPPROC)glfwGetProcAddress("glGenerateMipmap");
-#endif
-    glfwSetInputMode(_mainWindow, GLFW_STICKY_MOUSE_BUTTONS, 1);
-
-    gladLoadGL();
-}
-
-static void gl_close()
-{
-    glfwDestroyWindow(_mainWindow);
-    glfwTerminate();
-}
-
-static void load_image(const char *data, int len, SHADER_INPUT *inp, int is_cubemap)
-{
-    int n;
-    SAMPLER *s = &inp->sampler;
-    stbi_set_flip_vertically_on_load(s ? s->vflip : 0);
-    unsigned char *pix = stbi_load_from_memory((const stbi_uc *)data, len, &inp->w, &inp->h, &n, 4);
-    if (!pix)
-        return;
-    glGenTextures(1, &inp->tex); GLCHK;
-    int tgt = is_cubemap ? GL_TEXTURE_CUBE_MAP : GL_TEXTURE_2D;
-    glBindTexture(tgt, inp->tex); GLCHK;
-#ifndef USE_GLES3
-    glTexParameteri(tgt, GL_GENERATE_MIPMAP, GL_TRUE); GLCHK;
-#endif
-    int clamp = GL_CLAMP_TO_EDGE, min_filter = GL_LINEAR_MIPMAP_LINEAR, mag_filter = GL_LINEAR;
-    if (s)
-    {
-        clamp = (s->wrap && !is_cubemap) ? GL_REPEAT : GL_CLAMP_TO_EDGE;
-        if (!s->filter)
-        {
-            min_filter = GL_NEAREST;
-            mag_filter = GL_NEAREST;
-        } else if (1 == s->filter)
-            min_filter = GL_LINEAR;
-    }
-    glTexParameteri(tgt, GL_TEXTURE_MIN_FILTER, min_filter); GLCHK;
-    glTexParameteri(tgt, GL_TEXTURE_MAG_FILTER, mag_filter); GLCHK;
-    glTexParameteri(tgt, GL_TEXTURE_WRAP_S, clamp); GLCHK;
-    glTexParameteri(tgt, GL_TEXTURE_WRAP_T, clamp); GLCHK;
-    if (is_cubemap)
-    {
-        for (int i = 0; i < 6; i++)
-        {
-            glTexImage2D(GL_TEXTURE_CUBE_MAP_POSITIVE_X + i, 0, GL_RGBA8, inp->w, inp->h, 0, GL_RGBA, GL_UNSIGNED_BYTE, pix); GLCHK;
-        }
-    } else
-        glTexImage2D(tgt, 0, GL_RGBA8, inp->w, inp->h, 0, GL_RGBA, GL_UNSIGNED_BYTE, pix); GLCHK;
-#ifdef USE_GLES3
-    glGenerateMipmap(tgt); GLCHK;
-#endif
-    glBindTexture(tgt, 0); GLCHK;
-}
-
-static void update_cubemap(const char *data, int len, SHADER_INPUT *inp, int i)
-{
-    int n, w, h;
-    SAMPLER *s = &inp->sampler;
-    stbi_set_flip_vertically_on_load(s ? s->vflip : 0);
-    unsigned char *pix = stbi_load_from_memory((const stbi_uc *)data, len, &w, &h, &n, 4);
-    if (!pix)
-        return;
-    assert(inp->w == w && inp->h == h);
-    glBindTexture(GL_TEXTURE_CUBE_MAP, inp->tex); GLCHK;
-    glTexImage2D(GL_TEXTURE_CUBE_MAP_POSITIVE_X + i, 0, GL_RGBA8, inp->w, inp->h, 0, GL_RGBA, GL_UNSIGNED_BYTE, pix); GLCHK;
-    glBindTexture(GL_TEXTURE_CUBE_MAP, 0); GLCHK;
-}
-
-void fb_delete(FBO *f)
-{
-    if (f->framebuffer)
-        glDeleteFramebuffers(1, &f->framebuffer); GLCHK;
-    if (f->framebufferTex)
-        glDeleteTextures(1, &f->framebufferTex); GLCHK;
-}
-
-void fb_init(FBO *f, int width, int height, int float_tex)
-{
-    f->floatTex = float_tex;
-    glGenFramebuffers(1, &f->framebuffer); GLCHK;
-    glBindFramebuffer(GL_FRAMEBUFFER, f->framebuffer); GLCHK;
-    glGenTextures(1, &f->framebufferTex); GLCHK;
-    glBindTexture(GL_TEXTURE_2D, f->framebufferTex); GLCHK;
-    if (f->floatTex)
-        glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA16F, width, height, 0, GL_RGBA, GL_HALF_FLOAT, 0);
-    else
-        glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA, width, height, 0, GL_RGBA, GL_UNSIGNED_BYTE, 0);
-    GLCHK;
-    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR); GLCHK;
-    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR); GLCHK;
-    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE); GLCHK;
-    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE); GLCHK;
-    glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D, f->framebufferTex, 0); GLCHK;
-    glBindTexture(GL_TEXTURE_2D, 0); GLCHK;
-    glBindFramebuffer(GL_FRAMEBUFFER, 0); GLCHK;
-}
-
-void shader_delete(SHADER *s)
-{
-    if (s->shader)
-        glDeleteShader(s->shader);
-    if (s->prog)
-        glDeleteProgram(s->prog);
-}
-
-int shader_init(SHADER *s, const char *pCode, const char *pCommonCode/*, int is_compute*/)
-{
-    char header[1024];
-    snprintf(header, sizeof(header), shader_header, s->inputs[0].is_cubemap ? "Cube" : "2D",
-        s->inputs[1].is_cubemap ? "Cube" : "2D", s->inputs[2].is_cubemap ? "Cube" : "2D", s->inputs[3].is_cubemap ? "Cube" : "2D");
-    size_t hdr_len = strlen(header);
-    size_t source_len = strlen(pCode);
-    size_t common_len = pCommonCode ? strlen(pCommonCode) : 0;
-    size_t footer_len = strlen(shader_footer);
-    GLchar *sh = (GLchar *)malloc(hdr_len + source_len + common_len + footer_len + 1);
-    GLchar *psh = sh;
-    memcpy(psh, header, hdr_len); psh += hdr_len;
-    if (pCommonCode)
-    {
-        memcpy(psh, pCommonCode, common_len); psh += common_len;
-    }
-    memcpy(psh, pCode, source_len); psh += source_len;
-    *psh = 0;
-    if (!strstr(sh, "void main(") && !strstr(sh, "void main "))
-    {
-        memcpy(psh, shader_footer, footer_len); psh += footer_len;
-        *psh = 0;
-    }
-
-    s->prog = glCreateProgram(); GLCHK;
-    s->shader = glCreateShader(/*is_compute ? GL_COMPUTE_SHADER : */GL_FRAGMENT_SHADER); GLCHK;
-    glShaderSource(s->shader, 1, (const GLchar **)&sh, 0); GLCHK;
-    glCompileShader(s->shader); GLCHK;
-#ifdef _DEBUG
-    GLint isCompiled = 0;
-    glGetShaderiv(s->shader, GL_COMPILE_STATUS, &isCompiled);
-    if (isCompiled == GL_FALSE)
-    {
-        GLint maxLength = 0;
-        glGetShaderiv(s->shader, GL_INFO_LOG_LENGTH, &maxLength);
-        GLchar *errorLog = (GLchar *)malloc(maxLength);
-        glGetShaderInfoLog(s->shader, maxLength, &maxLength, &errorLog[0]);
-        printf("compile error: %s", errorLog);
-        printf("code: %s", sh);
-        exit(1);
-    }
-#endif
-    free(sh);
-    glAttachShader(s->prog, s->shader); GLCHK;
-    glLinkProgram(s->prog); GLCHK;
-#ifdef _DEBUG
-    GLint isLinked = 0;
-    glGetProgramiv(s->prog, GL_LINK_STATUS, &isLinked); GLCHK;
-    if (isLinked == GL_FALSE)
-    {
-        GLint maxLength = 0;
-        glGetProgramiv(s->prog, GL_INFO_LOG_LENGTH, &maxLength); GLCHK;
-        GLchar *errorLog = (GLchar *)malloc(maxLength);
-        glGetProgramInfoLog(s->prog, maxLength, &maxLength, &errorLog[0]); GLCHK;
-        printf("link error: %s", errorLog);
-        exit(1);
-    }
-#endif
-    s->iResolution = glGetUniformLocation(s->prog, "iResolution"); GLCHK;
-    s->iTime       = glGetUniformLocation(s->prog, "iTime"); GLCHK;
-    s->iTimeDelta  = glGetUniformLocation(s->prog, "iTimeDelta"); GLCHK;
-    s->iFrame      = glGetUniformLocation(s->prog, "iFrame"); GLCHK;
-    s->iMouse      = glGetUniformLocation(s->prog, "iMouse"); GLCHK;
-    s->iDate       = glGetUniformLocation(s->prog, "iDate"); GLCHK;
-    s->iSampleRate = glGetUniformLocation(s->prog, "iSampleRate"); GLCHK;
-    for (int i = 0; i < 4; i++)
-    {
-        char buf[64];
-        sprintf(buf, "iChannel%d", i);
-        s->iChannel[i] = glGetUniformLocation(s->prog, buf); GLCHK;
-        sprintf(buf, "iChannelTime[%d]", i);
-        s->iChannelTime[i] = glGetUniformLocation(s->prog, buf); GLCHK;
-        sprintf(buf, "iChannelResolution[%d]", i);
-        s->iChannelResolution[i] = glGetUniformLocation(s->prog, buf); GLCHK;
-    }
-    return 1;
-}
-
-void shadertoy_renderpass(SHADER *s, PLATFORM_PARAMS *p)
-{
-    glUseProgram(s->prog); GLCHK;
-    glUniform3f(s->iResolution, (float)p->winWidth, (float)p->winHeight, 1.0f); GLCHK;
-    glUniform1f(s->iTime, p->cur_time); GLCHK;
-    glUniform1f(s->iTimeDelta, p->cur_time - p->time_last); GLCHK;
-    glUniform1i(s->iFrame, p->frame++); GLCHK;
-    if(p->cx > -0.5f)
-        glUniform4f(s->iMouse, p->mx, p->my, p->cx, p->cy); GLCHK;
-    glUniform4f(s->iDate, p->tm->tm_year, p->tm->tm_mon, p->tm->tm_mday, p->tm->tm_hour*3600 + p->tm->tm_min*60 + p->tm->tm_sec); GLCHK;
-    glUniform1f(s->iSampleRate, 0); GLCHK;
-
-    glActiveTexture(GL_TEXTURE0); GLCHK;
-    glBindTexture(GL_TEXTURE_2D, 0); GLCHK;
-    glColor4f(0.0f, 0.0f, 0.0f, 1.0f); GLCHK;
-    for (int i = 0, tu = 1; i < 4; i++)
-    {
-        glUniform1f(s->iChannelTime[i], p->cur_time); GLCHK;
-        //int w = 0, h = 0;
-        if (s->inputs[i].tex)
-        {
-            int tgt = s->inputs[i].is_cubemap ? GL_TEXTURE_CUBE_MAP : GL_TEXTURE_2D;
-            glActiveTexture(GL_TEXTURE0 + tu); GLCHK;
-            glBindTexture(tgt, s->inputs[i].tex); GLCHK;
-            glUniform1i(s->iChannel[i], tu); GLCHK;
-            tu++;
-        } else
-            glUniform1i(s->iChannel[i], 0); GLCHK;
-        glUniform3f(s->iChannelResolution[i], s->inputs[i].w, s->inputs[i].h, 1.0f); GLCHK;
-    }
-
-    glRecti(1, 1, -1, -1); GLCHK;
-    glUseProgram(0); GLCHK;
-}
-
-static int switch_val(jfes_value_t *str, const char **vals)
-{
-    for (int i = 0; *vals; i++, vals++)
-        if (!strcmp(*vals, str->data.string_val.data))
-            return i;
-    perror(str->data.string_val.data);
-    assert(0);
-    return -1;
-}
-
-int load_json(SHADER *shaders, char *buffer, int buf_size)
-{
-    jfes_config_t config;
-    config.jfes_malloc = (jfes_malloc_t)malloc;
-    config.jfes_free = free;
-
-    jfes_value_t value;
-    jfes_status_t status = jfes_parse_to_value(&config, buffer, buf_size, &value);
-    if (!jfes_status_is_good(status))
-       return 1;
-    jfes_value_t *root = value.data.array_val->items[0];
-    jfes_value_t *rp = jfes_get_child(root, "renderpass", 0);
-
-    char *common_code = 0;
-    for (int i = 0; i < rp->data.array_val->count; i++)
-    {
-        SHADER *s = &shaders[i];
-        jfes_value_t *pass = rp->data.array_val->items[i];
-        jfes_value_t *type = jfes_get_child(pass, "type", 0);
-        static const char *rp_types[] = { "image", "common", "buffer", "cubemap", "sound", 0 };
-        s->type = switch_val(type, rp_types);
-        if (1 == s->type)
-        {
-            if (common_code)
-            {
-                printf("error: common code already exists.");
-                exit(1);
-            }
-            jfes_value_t *code = jfes_get_child(pass, "code", 0);
-            common_code = strdup(code->data.string_val.data);
-            unescape_json(code->data.string_val.data, code->data.string_val.size, common_code);
-        }
-    }
-    for (int i = 0; i < rp->data.array_val->count; i++)
-    {
-        SHADER *s = &shaders[i];
-        jfes_value_t *pass = rp->data.array_val->items[i];
-        jfes_value_t *inputs  = jfes_get_child(pass, "inputs", 0);
-        jfes_value_t *outputs = jfes_get_child(pass, "outputs", 0);
-        jfes_value_t *code    = jfes_get_child(pass, "code", 0);
-        if (s->type)
-            continue;
-        int j;
-        for (j = 0; j < inputs->data.array_val->count; j++)
-        {
-           static const char *types[] = { "texture", "buffer", "cubemap", "musicstream", "music", "keyboard", 0 };
-           jfes_value_t *input = inputs->data.array_val->items[j];
-           jfes_value_t *iid   = jfes_get_child(input, "id", 0);
-           int itype = switch_val(jfes_get_child(input, "type", 0), types);
-           jfes_value_t *ichannel = jfes_get_child(input, "channel", 0);
-           jfes_value_t *filepath = jfes_get_child(input, "filepath", 0);
-           jfes_value_t *sampler  = jfes_get_child(input, "sampler", 0);
-           SHADER_INPUT *inp = s->inputs + ichannel->data.int_val;
-           SAMPLER *smp = &inp->sampler;
-           inp->id = iid->data.string_val.data;
-           inp->is_cubemap = (2 == itype);
-           if (sampler)
-           {
-              static const char *filter[] = { "nearest", "linear", "mipmap", 0 };
-              static const char *wrap[]   = { "clamp", "repeat", 0 };
-              static const char *bools[]  = { "false", "true", 0 };
-              static const char *internal[] = { "byte", 0 };
-              smp->filter = switch_val(jfes_get_child(sampler, "filter", 0), filter);
-              smp->wrap   = switch_val(jfes_get_child(sampler, "wrap", 0), wrap);
-              smp->vflip  = switch_val(jfes_get_child(sampler, "vflip", 0), bools);
-              smp->srgb   = switch_val(jfes_get_child(sampler, "srgb", 0), bools);
-              smp->internal = switch_val(jfes_get_child(sampler, "internal", 0), internal);
-           }
-           if (filepath && (0 == itype || inp->is_cubemap))
-           {
-                int components = inp->is_cubemap ? 6 : 1;
-                char *buf = malloc(filepath->data.string_val.size + 26 + 2);
-                for (j = 0; j < components; j++)
-                {
-                    strcpy(buf, "https://www.shadertoy.com");
-                    unescape_json(filepath->data.string_val.data, filepath->data.string_val.size, buf + 25);
-                    if (j)
-                    {
-                        char *s = strrchr(buf, '.');
-                        if (s)
-                        {
-                            int len = strlen(s);
-                            s[len + 2] = 0;
-                            for (; len; len--)
-                                s[len + 1] = s[len - 1];
-                            s[0] = '_';
-                            s[1] = '0' + j;
-                        }
-                    }
-                    char *img = load_file(buf + 26, &buf_size);
-#ifdef HAVE_CURL
-                    if (!img)
-                    {
-                        img = load_url(buf, &buf_size, 0);
-                        printf("load %s (%d bytes)\n", buf, buf_size);
-                        mkpath(buf + 26);
-                        FILE *f = fopen(buf + 26, "wb");
-                        if (f)
-                        {
-                            fwrite(img, 1, buf_size, f);
-                            fclose(f);
-                        }
-                    }
-#endif
-                     if (img)
-                     {
-                         if (0 == j)
-                             load_image(img, buf_size, inp, inp->is_cubemap);
-                         else
-                             update_cubemap(img, buf_size, inp, j);
-                         free(img);
-                     }
-                }
-                free(buf);
-           }
-           //printf("i type=%d, id=%s, channel=%d\n", itype, inp->id, ichannel->data.int_val);
-        }
-        for (j = 0; j < outputs->data.array_val->count; j++)
-        {
-           jfes_value_t *output = outputs->data.array_val->items[j];
-           jfes_value_t *oid    = jfes_get_child(output, "id", 0);
-           //jfes_value_t *ochannel = jfes_get_child(output, "channel", 0);
-           s->output.id = oid->data.string_val.data;
-           //printf("o id=%s, channel=%d\n", s->output.id, ochannel->data.int_val);
-        }
-        //printf("type=%s\n", type->data.string_val.data);
-        char *unesc_buf = strdup(code->data.string_val.data);
-        unescape_json(code->data.string_val.data, code->data.string_val.size, unesc_buf);
-        shader_init(s, unesc_buf, common_code);
-        free(unesc_buf);
-    }
-    jfes_free_value(&config, &value);
-    return 0;
-}
-
-int main(int argc, char **argv)
-{
-    int buf_size;
-    char *buffer;
-    if (argc < 2)
-    {
-        printf("usage: toy url or file\n");
-        return 0;
-    }
-    int is_url = 0 != strstr(argv[1], "://");
-#ifdef HAVE_CURL
-    if (is_url)
-        buffer = load_url(argv[1], &buf_size, 1);
-    else
-#endif
-        buffer = load_file(argv[1], &buf_size);
-    if (!buffer)
-        return 1;
-
-    char result[PATH_MAX];
-    ssize_t count = readlink("/proc/self/exe", result, PATH_MAX);
-    int res = chdir(dirname(result));
-    (void)res;
-    gl_init();
-
-    SHADER shaders[5];
-    memset(shaders, 0, sizeof(shaders));
-    if (buffer[0] != '[' || load_json(shaders, buffer, buf_size))
-    {   // not a json
-        if (is_url)
-            return 1;
-        shader_init(shaders, buffer, 0);
-    }
-    if (buffer)
-        free(buffer);
-
-    PLATFORM_PARAMS p;
-    memset(&p, 0, sizeof(p));
-    double time_start = glfwGetTime(), time_last = time_start;
-    while (!glfwWindowShouldClose(_mainWindow))
-    {
-        glfwPollEvents();
-        if (glfwGetKey(_mainWindow, GLFW_KEY_ESCAPE))
-            glfwSetWindowShouldClose(_mainWindow, 1);
-        int width, height, mkeys = 0;
-        double mx, my;
-        glfwGetWindowSize(_mainWindow, &p.winWidth, &p.winHeight);
-        glfwGetFramebufferSize(_mainWindow, &width, &height);
-        glfwGetCursorPos(_mainWindow, &mx, &my);
-        p.mx = mx, p.my = my;
-        p.cx = -1.0f, p.cy = -1.0f;
-        if (GLFW_PRESS == glfwGetMouseButton(_mainWindow, GLFW_MOUSE_BUTTON_LEFT))
-        {
-            p.cx = mx, p.cy = my;
-        }
-        glViewport(0, 0, p.winWidth, p.winHeight); GLCHK;
-        glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT | GL_STENCIL_BUFFER_BIT); GLCHK;
-
-        p.cur_time = glfwGetTime() - time_start;
-        time_t rawtime;
-        time(&rawtime);
-        p.tm = localtime(&rawtime);
-
-        shadertoy_renderpass(&shaders[0], &p);
-        p.time_last = p.cur_time;
-        glfwSwapBuffers(_mainWindow);
-    }
-    return 0;
-}
+#define _DEFAULT_SOURCE // MAP_POPULATE, build.sh only asks for POSIX
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <strings.h>
+#include <assert.h>
+#include <time.h>
+#include <sys/stat.h>
+#include <libgen.h>
+#include <unistd.h>
+#include <errno.h>
+#include <limits.h>
+#include <pthread.h>
+#include <fcntl.h>
+#ifndef __MINGW32__
+#include <sys/mman.h>
+#endif
+#include "glad.h"
+#include "jfes/jfes.h"
+#include <GLFW/glfw3.h>
+#ifdef HAVE_EGL
+#include <EGL/egl.h>
+#include <EGL/eglext.h>
+#endif
+#include "minishadertoy.h"
+#define STB_IMAGE_IMPLEMENTATION
+#include "stb_image.h"
+
+#ifndef __MINGW32__
+#define MKDIRARGS ,0777
+#else
+#define MKDIRARGS
+#endif
+
+static GLFWwindow *_mainWindow;
+static GLuint _vertexShader, _fullscreenVao;
+#ifdef HAVE_EGL
+static EGLDisplay _eglDisplay = EGL_NO_DISPLAY;
+static EGLSurface _eglSurface = EGL_NO_SURFACE;
+static EGLContext _eglContext = EGL_NO_CONTEXT;
+static EGLConfig _eglConfig = EGL_NO_CONFIG_KHR;
+#endif
+
+static const char *shader_header = 
+    "#version 300 es\n"
+    "#extension GL_EXT_shader_texture_lod : enable\n"
+    "#extension GL_OES_standard_derivatives : enable\n"
+    "#define iGlobalTime iTime\n"
+    "precision highp float;\n"
+    "precision highp int;\n"
+    "precision highp sampler2D;\n"
+    "out vec4 fragmentColor;\n"
+    "uniform vec3      iResolution;\n"
+    "uniform float     iTime;\n"
+    "uniform float     iTimeDelta;\n"
+    "uniform int       iFrame;\n"
+    "uniform float     iChannelTime[4];\n"
+    "uniform vec3      iChannelResolution[4];\n"
+    "uniform vec4      iMouse;\n"
+    "uniform vec4      iDate;\n"
+    "uniform float     iSampleRate;\n";
+
+static const char *shader_channels =
+    "uniform sampler%s iChannel0;\n"
+    "uniform sampler%s iChannel1;\n"
+    "uniform sampler%s iChannel2;\n"
+    "uniform sampler%s iChannel3;\n";
+
+static const char *vertex_shader =
+    "#version 300 es\n"
+    "void main(void) {\n"
+    "    // fullscreen triangle (-1,-1) (3,-1) (-1,3)\n"
+    "    vec2 p = vec2(float((gl_VertexID << 1) & 2), float(gl_VertexID & 2));\n"
+    "    gl_Position = vec4(p*2.0 - 1.0, 0.0, 1.0);\n"
+    "}\n";
+
+static const char *shader_footer = 
+    "\nvoid main(void) {\n"
+    "    vec4 color = vec4(0.0,0.0,0.0,1.0);\n"
+    "    mainImage(color, gl_FragCoord.xy);\n"
+    "    color.w = 1.0;\n"
+    "    fragmentColor = color;\n"
+    "}\n";
+
+#ifdef HAVE_CURL
+#include <curl/curl.h>
+
+struct buffer
+{
+    char *m_buffer;
+    int m_buf_size, m_capacity;
+    CURL *m_curl;
+};
+
+static size_t buffer_write_cb(void *ptr, size_t size, size_t nmemb, void *stream)
+{   // sized from Content-Length when the server sends it, doubled otherwise
+    struct buffer *b = (struct buffer *)stream;
+    size_t len = size*nmemb, need = (size_t)b->m_buf_size + len;
+    if (need > INT_MAX)
+        return 0;
+    if (need > (size_t)b->m_capacity)
+    {
+        size_t capacity = b->m_capacity ? (size_t)b->m_capacity*2 : 64*1024;
+        curl_off_t content_length = -1;
+        if (!b->m_buffer && b->m_curl)
+            curl_easy_getinfo(b->m_curl, CURLINFO_CONTENT_LENGTH_DOWNLOAD_T, &content_length);
+        if (content_length > 0 && content_length < INT_MAX)
+            capacity = content_length;
+        if (capacity < need)
+            capacity = need;
+        if (capacity > INT_MAX)
+            capacity = INT_MAX;
+        char *buffer = (char *)realloc(b->m_buffer, capacity);
+        if (!buffer)
+            return 0; // aborts the transfer
+        b->m_buffer = buffer, b->m_capacity = (int)capacity;
+    }
+    memcpy(b->m_buffer + b->m_buf_size, ptr, len);
+    b->m_buf_size += (int)len;
+    return len;
+}
+
+// dns and tls sessions are shared by every transfer, including the reload thread. Connections are not,
+// libcurl does not support that across threads, downloads reuse them through their multi handle and
+// single requests through an easy handle kept per thread
+static CURLSH *_curlShare;
+static pthread_mutex_t _curlShareLocks[CURL_LOCK_DATA_LAST];
+static pthread_once_t _curlShareOnce = PTHREAD_ONCE_INIT;
+static pthread_key_t _curlHandle;
+
+static void curl_share_lock(CURL *handle, curl_lock_data data, curl_lock_access access, void *user)
+{
+    pthread_mutex_lock(&_curlShareLocks[data]);
+}
+
+static void curl_share_unlock(CURL *handle, curl_lock_data data, void *user)
+{
+    pthread_mutex_unlock(&_curlShareLocks[data]);
+}
+
+static void curl_handle_free(void *curl)
+{
+    curl_easy_cleanup((CURL *)curl);
+}
+
+static void curl_share_setup()
+{   // curl_global_init() already ran in main()
+    pthread_key_create(&_curlHandle, curl_handle_free);
+    for (int i = 0; i < CURL_LOCK_DATA_LAST; i++)
+        pthread_mutex_init(&_curlShareLocks[i], NULL);
+    _curlShare = curl_share_init();
+    if (!_curlShare)
+        return;
+    curl_share_setopt(_curlShare, CURLSHOPT_LOCKFUNC, curl_share_lock);
+    curl_share_setopt(_curlShare, CURLSHOPT_UNLOCKFUNC, curl_share_unlock);
+    curl_share_setopt(_curlShare, CURLSHOPT_SHARE, CURL_LOCK_DATA_DNS);
+    curl_share_setopt(_curlShare, CURLSHOPT_SHARE, CURL_LOCK_DATA_SSL_SESSION);
+}
+
+// connection and request rate limits for every transfer
+static struct
+{
+    long connections;
+    double rate; // request starts per second, 0 for no limit
+    double next; // earliest start of the next request
+    pthread_mutex_t lock;
+} _net = { 6, 0, 0, PTHREAD_MUTEX_INITIALIZER };
+
+static int net_throttle(int wait)
+{   // 1 when a request may start, starts are spaced 1/rate apart across all threads
+    struct timespec ts;
+    double now, delay = 0;
+    int res = 1;
+    if (_net.rate <= 0)
+        return 1;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    now = ts.tv_sec + ts.tv_nsec*1e-9;
+    pthread_mutex_lock(&_net.lock);
+    if (_net.next <= now)
+        _net.next = now + 1.0/_net.rate;
+    else if (wait)
+    {
+        delay = _net.next - now;
+        _net.next += 1.0/_net.rate;
+    } else
+        res = 0;
+    pthread_mutex_unlock(&_net.lock);
+    if (delay > 0)
+    {
+        ts.tv_sec = (time_t)delay, ts.tv_nsec = (long)((delay - ts.tv_sec)*1e9);
+        nanosleep(&ts, NULL);
+    }
+    return res;
+}
+
+static CURL *curl_init()
+{
+    pthread_once(&_curlShareOnce, curl_share_setup);
+    CURL *curl = curl_easy_init();
+    if (curl && _curlShare)
+        curl_easy_setopt(curl, CURLOPT_SHARE, _curlShare);
+    return curl;
+}
+
+static CURL *curl_thread_handle()
+{   // reset for every request, the connections it holds stay alive for the next one
+    pthread_once(&_curlShareOnce, curl_share_setup);
+    CURL *curl = (CURL *)pthread_getspecific(_curlHandle);
+    if (curl)
+    {
+        curl_easy_reset(curl);
+        if (_curlShare)
+            curl_easy_setopt(curl, CURLOPT_SHARE, _curlShare);
+        return curl;
+    }
+    curl = curl_init();
+    if (curl)
+        pthread_setspecific(_curlHandle, curl);
+    return curl;
+}
+
+typedef struct HTTP_VALIDATORS
+{
+    char etag[128]; // sent as If-None-Match, replaced by the response's
+    int64_t modified; // sent as If-Modified-Since, replaced by Last-Modified, 0 if unknown
+    long status;
+} HTTP_VALIDATORS;
+
+static size_t etag_header_cb(char *ptr, size_t size, size_t nmemb, void *user)
+{
+    HTTP_VALIDATORS *v = (HTTP_VALIDATORS *)user;
+    size_t len = size*nmemb;
+    if (len > 5 && !strncasecmp(ptr, "etag:", 5))
+    {
+        size_t start = 5, end = len;
+        while (start < end && ' ' == ptr[start])
+            start++;
+        while (end > start && strchr(" \r\n", ptr[end - 1]))
+            end--;
+        if (end - start < sizeof(v->etag))
+        {
+            memcpy(v->etag, ptr + start, end - start);
+            v->etag[end - start] = 0;
+        }
+    }
+    return len;
+}
+
+static char *load_url(const char *url, int *size, int is_post, HTTP_VALIDATORS *v)
+{   // with validators a 304 returns no data and v->status tells it apart from a failure
+    struct buffer b = { 0 };
+    struct curl_slist *headers = 0;
+    CURL *curl;
+    CURLcode res;
+    curl = curl_thread_handle(); // a prefetch thread sends thousands of requests on it
+    if (!curl)
+        return 0;
+    b.m_curl = curl;
+    net_throttle(1);
+    if (is_post)
+    {
+        char buf[256];
+        char *id = strrchr(url, '/');
+        if (!id)
+            goto fail;
+        snprintf(buf, sizeof(buf), "s={ \"shaders\" : [\"%s\"] }", id + 1);
+        curl_easy_setopt(curl, CURLOPT_URL, "https://www.shadertoy.com/shadertoy");
+        curl_easy_setopt(curl, CURLOPT_COPYPOSTFIELDS, buf);
+        curl_easy_setopt(curl, CURLOPT_REFERER, "https://www.shadertoy.com/browse");
+    } else
+        curl_easy_setopt(curl, CURLOPT_URL, url);
+    curl_easy_setopt(curl, CURLOPT_WRITEFUNCTION, buffer_write_cb);
+    curl_easy_setopt(curl, CURLOPT_WRITEDATA, &b);
+    if (v)
+    {
+        char buf[160];
+        if (v->etag[0])
+        {
+            snprintf(buf, sizeof(buf), "If-None-Match: %s", v->etag);
+            headers = curl_slist_append(headers, buf);
+            curl_easy_setopt(curl, CURLOPT_HTTPHEADER, headers);
+        }
+        if (v->modified)
+        {
+            curl_easy_setopt(curl, CURLOPT_TIMECONDITION, (long)CURL_TIMECOND_IFMODSINCE);
+            curl_easy_setopt(curl, CURLOPT_TIMEVALUE_LARGE, (curl_off_t)v->modified);
+        }
+        curl_easy_setopt(curl, CURLOPT_FILETIME, 1L);
+        curl_easy_setopt(curl, CURLOPT_HEADERFUNCTION, etag_header_cb);
+        curl_easy_setopt(curl, CURLOPT_HEADERDATA, v);
+        v->etag[0] = 0, v->status = 0;
+    }
+    res = curl_easy_perform(curl);
+    if (res != CURLE_OK)
+    {
+        if (b.m_buffer)
+            free(b.m_buffer);
+        b.m_buffer = 0, b.m_buf_size = 0;
+        printf("curl_easy_perform() failed: %s\n", curl_easy_strerror(res));
+    } else if (v)
+    {
+        curl_off_t filetime = -1;
+        curl_easy_getinfo(curl, CURLINFO_RESPONSE_CODE, &v->status);
+        curl_easy_getinfo(curl, CURLINFO_FILETIME_T, &filetime);
+        v->modified = filetime > 0 ? filetime : 0;
+    }
+fail:
+    curl_slist_free_all(headers);
+    *size = b.m_buf_size;
+    //printf("%d readed\n", *size);
+    return b.m_buffer;
+}
+
+typedef void (*download_cb)(void *user, int index, char *data, int size);
+
+static void download_all(const char **urls, int count, download_cb done, void *user, const volatile int *cancel)
+{   // all at once within the connection and rate limits, done() gets each buffer (0 on failure)
+    // in completion order and owns it
+    CURLM *multi = curl_multi_init();
+    struct buffer *bufs = (struct buffer *)calloc(count, sizeof(struct buffer));
+    CURL **handles = (CURL **)calloc(count, sizeof(CURL *));
+    int running = 0, added = 0, in_flight = 0;
+    curl_multi_setopt(multi, CURLMOPT_PIPELINING, CURLPIPE_MULTIPLEX);
+    curl_multi_setopt(multi, CURLMOPT_MAX_HOST_CONNECTIONS, _net.connections);
+    curl_multi_setopt(multi, CURLMOPT_MAX_TOTAL_CONNECTIONS, _net.connections);
+    while ((running || added < count) && !(cancel && *cancel))
+    {
+        CURLMsg *msg;
+        int left;
+        // a few queued per connection keeps them busy without an easy handle per file of a long list
+        while (added < count && in_flight < _net.connections*4 && net_throttle(0))
+        {
+            int i = added++;
+            CURL *curl = curl_init();
+            if (!curl)
+            {
+                done(user, i, 0, 0);
+                continue;
+            }
+            curl_easy_setopt(curl, CURLOPT_URL, urls[i]);
+            curl_easy_setopt(curl, CURLOPT_FAILONERROR, 1L);
+            curl_easy_setopt(curl, CURLOPT_WRITEFUNCTION, buffer_write_cb);
+            curl_easy_setopt(curl, CURLOPT_WRITEDATA, &bufs[i]);
+            bufs[i].m_curl = curl;
+            curl_easy_setopt(curl, CURLOPT_PRIVATE, &bufs[i]);
+            curl_multi_add_handle(multi, curl);
+            handles[i] = curl;
+            in_flight++;
+        }
+        curl_multi_perform(multi, &running);
+        while ((msg = curl_multi_info_read(multi, &left)))
+        {
+            if (CURLMSG_DONE != msg->msg)
+                continue;
+            struct buffer *b;
+            curl_easy_getinfo(msg->easy_handle, CURLINFO_PRIVATE, (char **)&b);
+            int i = b - bufs;
+            if (CURLE_OK != msg->data.result)
+            {
+                printf("load %s failed: %s\n", urls[i], curl_easy_strerror(msg->data.result));
+                if (b->m_buffer)
+                    free(b->m_buffer);
+                b->m_buffer = 0, b->m_buf_size = 0;
+            }
+            curl_multi_remove_handle(multi, msg->easy_handle);
+            curl_easy_cleanup(msg->easy_handle);
+            handles[i] = 0;
+            in_flight--;
+            done(user, i, b->m_buffer, b->m_buf_size);
+        }
+        if (running || added < count)
+            curl_multi_poll(multi, NULL, 0, added < count ? 10 : 100, NULL);
+    }
+    for (int i = 0; i < added; i++)
+        if (handles[i])
+        {   // cancelled
+            curl_multi_remove_handle(multi, handles[i]);
+            curl_easy_cleanup(handles[i]);
+            if (bufs[i].m_buffer)
+                free(bufs[i].m_buffer);
+        }
+    free(handles);
+    free(bufs);
+    curl_multi_cleanup(multi);
+}
+#endif
+
+static int mkpath(char *path)
+{
+    int len = (int)strlen(path);
+    if (len <= 0)
+        return 0;
+
+    char *buffer = (char*)malloc(len + 1);
+    if (!buffer)
+        goto fail;
+    strcpy(buffer, path);
+
+    if (buffer[len - 1] == '/')
+    {
+        buffer[len - 1] = '\0';
+        if (!mkdir(buffer MKDIRARGS))
+        {
+            free(buffer);
+            return 1;
+        }
+        buffer[len - 1] = '/';
+    }
+
+    char *p = buffer + 1;
+    while (1)
+    {
+        while (*p && *p != '\\' && *p != '/')
+            p++;
+        if (!*p)
+            break;
+        char sav = *p;
+        *p = 0;
+        if ((mkdir(buffer MKDIRARGS) == -1) && (errno == ENOENT))
+            goto fail;
+        *p++ = sav;
+    }
+    free(buffer);
+    return 1;
+fail:
+    printf("error: creating %s failed", path);
+    if (buffer)
+        free(buffer);
+    return 0;
+}
+
+static unsigned char *load_file(const char *fname, int *data_size)
+{
+    FILE *file = fopen(fname, "rb");
+    unsigned char *data;
+    *data_size = 0;
+    if (!file)
+        return 0;
+    fseek(file, 0, SEEK_END);
+    *data_size = (int)ftell(file);
+    fseek(file, 0, SEEK_SET);
+    data = (unsigned char*)malloc(*data_size + 1);
+    if (!data)
+        goto fail;
+    if ((int)fread(data, 1, *data_size, file) != *data_size)
+        exit(1);
+    data[*data_size] = 0;
+fail:
+    fclose(file);
+    return data;
+}
+
+#define FNV_OFFSET 0xcbf29ce484222325ull
+
+static uint64_t fnv1a(const void *data, size_t len, uint64_t h)
+{
+    const unsigned char *p = (const unsigned char *)data;
+    for (size_t i = 0; i < len; i++)
+        h = (h ^ p[i])*0x100000001b3ull;
+    return h;
+}
+
+// content addressed cache shared by concurrent processes: objects/xx/<content hash> are written
+// through a rename, the index maps name keys to objects with their size and last use for LRU
+// eviction under the byte budget. Index updates hold an fcntl lock on the lock file, which does
+// not exclude threads of the same process, so there is a mutex as well
+typedef struct STORE_ENTRY
+{
+    uint64_t key, hash, size;
+    int64_t used;
+} STORE_ENTRY;
+
+#define STORE_TOUCH_SECS 60 // last use granularity, saves index writes on hits
+
+static struct
+{
+    char root[PATH_MAX - 64]; // room for the file names below it
+    uint64_t budget;
+    int offline; // never touch the network, everything comes from the cache
+    pthread_mutex_t lock;
+    STORE_ENTRY *pending; // batched index updates, see store_batch()
+    int num_pending;
+    pthread_mutex_t pending_lock;
+} _store = { "cache", 2ull << 30, 0, PTHREAD_MUTEX_INITIALIZER, 0, 0, PTHREAD_MUTEX_INITIALIZER };
+
+#define STORE_BATCH 256
+
+static void store_object_path(char *buf, uint64_t hash)
+{
+    snprintf(buf, PATH_MAX, "%s/objects/%02x/%016llx", _store.root, (unsigned)(hash >> 56), (unsigned long long)hash);
+}
+
+static int store_lock()
+{
+    char fname[PATH_MAX];
+    int fd = -1;
+    pthread_mutex_lock(&_store.lock);
+#ifndef __MINGW32__
+    snprintf(fname, sizeof(fname), "%s/lock", _store.root);
+    mkpath(fname);
+    fd = open(fname, O_RDWR | O_CREAT, 0666);
+    struct flock fl;
+    memset(&fl, 0, sizeof(fl));
+    fl.l_type = F_WRLCK, fl.l_whence = SEEK_SET;
+    while (fd >= 0 && fcntl(fd, F_SETLKW, &fl) && EINTR == errno)
+        ;
+#endif
+    return fd;
+}
+
+static void store_unlock(int fd)
+{
+    if (fd >= 0)
+        close(fd); // drops the fcntl lock
+    pthread_mutex_unlock(&_store.lock);
+}
+
+static STORE_ENTRY *store_index_read(int *count, int extra)
+{   // "TOYI", entry count, entries; a missing or damaged index is an empty cache
+    char fname[PATH_MAX];
+    int size;
+    uint32_t n = 0;
+    snprintf(fname, sizeof(fname), "%s/index", _store.root);
+    unsigned char *data = load_file(fname, &size);
+    if (data && size >= 8 && !memcmp(data, "TOYI", 4))
+        memcpy(&n, data + 4, sizeof(n));
+    if (!data || (size_t)size != 8 + n*sizeof(STORE_ENTRY))
+        n = 0;
+    STORE_ENTRY *e = (STORE_ENTRY *)malloc((n + extra + 1)*sizeof(STORE_ENTRY)); // room for inserts
+    if (e && n)
+        memcpy(e, data + 8, n*sizeof(STORE_ENTRY));
+    if (data)
+        free(data);
+    *count = e ? n : 0;
+    return e;
+}
+
+static void store_index_write(STORE_ENTRY *e, int count)
+{
+    char fname[PATH_MAX], tmp_name[PATH_MAX + 16];
+    uint32_t n = count;
+    snprintf(fname, sizeof(fname), "%s/index", _store.root);
+    snprintf(tmp_name, sizeof(tmp_name), "%s.%d", fname, (int)getpid());
+    FILE *f = fopen(tmp_name, "wb");
+    if (!f)
+        return;
+    int ok = fwrite("TOYI", 1, 4, f) == 4 && fwrite(&n, sizeof(n), 1, f) == 1 && (int)fwrite(e, sizeof(STORE_ENTRY), count, f) == count;
+    ok = !fclose(f) && ok;
+    if (!ok || rename(tmp_name, fname))
+        remove(tmp_name);
+}
+
+static int store_find(const char *name, STORE_ENTRY *found)
+{
+    int count, res = 0, fd = store_lock();
+    uint64_t key = fnv1a(name, strlen(name), FNV_OFFSET);
+    int64_t now = time(NULL);
+    STORE_ENTRY *e = store_index_read(&count, 0);
+    for (int i = 0; e && i < count && !res; i++)
+        if (e[i].key == key)
+        {
+            res = 1;
+            *found = e[i];
+            if (now - e[i].used > STORE_TOUCH_SECS)
+            {
+                e[i].used = now;
+                store_index_write(e, count);
+            }
+        }
+    if (e)
+        free(e);
+    store_unlock(fd);
+    return res;
+}
+
+static unsigned char *store_get(const char *name, int *size)
+{
+    char fname[PATH_MAX];
+    STORE_ENTRY e;
+    *size = 0;
+    if (!store_find(name, &e))
+        return 0;
+    store_object_path(fname, e.hash);
+    unsigned char *data = load_file(fname, size);
+    if (data && (uint64_t)*size != e.size)
+    {
+        free(data);
+        data = 0, *size = 0;
+    }
+    return data;
+}
+
+#ifndef __MINGW32__
+static void *store_map(const char *name, size_t *size)
+{   // read only, release with munmap()
+    char fname[PATH_MAX];
+    STORE_ENTRY e;
+    struct stat st;
+    void *map = MAP_FAILED;
+    int flags = MAP_PRIVATE;
+#ifdef MAP_POPULATE
+    flags |= MAP_POPULATE; // fault the pages in on the calling thread
+#endif
+    *size = 0; // the caller decodes the asset again
+    if (!store_find(name, &e))
+        return 0;
+    store_object_path(fname, e.hash);
+    int fd = open(fname, O_RDONLY);
+    if (fd < 0)
+        return 0;
+    if (!fstat(fd, &st) && (uint64_t)st.st_size == e.size && st.st_size > 0)
+        map = mmap(0, st.st_size, PROT_READ, flags, fd, 0);
+    close(fd);
+    if (MAP_FAILED == map)
+        return 0;
+    *size = st.st_size;
+    return map;
+}
+#endif
+
+static int store_referenced(const STORE_ENTRY *e, int count, int skip, uint64_t hash)
+{   // objects are shared by names with the same content
+    for (int i = 0; i < count; i++)
+        if (i != skip && e[i].hash == hash)
+            return 1;
+    return 0;
+}
+
+static void store_evict(STORE_ENTRY *e, int *count, int keep)
+{   // least recently used first until under budget, never the entry at keep
+    char fname[PATH_MAX];
+    uint64_t total = 0;
+    int i, n = *count;
+    for (i = 0; i < n; i++)
+        total += e[i].size;
+    while (total > _store.budget && n > (keep >= 0))
+    {
+        int lru = -1;
+        for (i = 0; i < n; i++)
+            if (i != keep && (lru < 0 || e[i].used < e[lru].used))
+                lru = i;
+        if (!store_referenced(e, n, lru, e[lru].hash))
+        {
+            store_object_path(fname, e[lru].hash);
+            remove(fname);
+        }
+        total -= e[lru].size;
+        e[lru] = e[--n];
+        if (keep == n)
+            keep = lru;
+    }
+    *count = n;
+}
+
+static void store_trim()
+{   // applies a smaller budget right away
+    int count, fd = store_lock();
+    STORE_ENTRY *e = store_index_read(&count, 0);
+    if (e)
+    {
+        int n = count;
+        store_evict(e, &count, -1);
+        if (n != count)
+            store_index_write(e, count);
+        free(e);
+    }
+    store_unlock(fd);
+}
+
+static void store_index_add(STORE_ENTRY *add, int num_add)
+{
+    int count, fd = store_lock();
+    STORE_ENTRY *e = store_index_read(&count, num_add);
+    if (e)
+    {
+        char fname[PATH_MAX];
+        int i = -1;
+        for (int k = 0; k < num_add; k++)
+        {
+            for (i = 0; i < count && e[i].key != add[k].key; i++)
+                ;
+            if (i == count)
+                count++;
+            else if (e[i].hash != add[k].hash && !store_referenced(e, count, i, e[i].hash) &&
+                !store_referenced(add + k, num_add - k, -1, e[i].hash))
+            {   // new content under the same name, nothing else uses the old object
+                store_object_path(fname, e[i].hash);
+                remove(fname);
+            }
+            e[i] = add[k];
+        }
+        store_evict(e, &count, i);
+        store_index_write(e, count);
+        free(e);
+    }
+    store_unlock(fd);
+}
+
+static void store_batch(int enable)
+{   // rewriting the index per file does not scale to bulk downloads, a batch rewrites it every
+    // STORE_BATCH puts and when disabled. Batched entries are not found until they are written
+    STORE_ENTRY *pending;
+    int count;
+    pthread_mutex_lock(&_store.pending_lock);
+    pending = _store.pending, count = _store.num_pending;
+    _store.pending = enable ? (STORE_ENTRY *)malloc(STORE_BATCH*sizeof(STORE_ENTRY)) : 0;
+    _store.num_pending = 0;
+    pthread_mutex_unlock(&_store.pending_lock);
+    if (count)
+        store_index_add(pending, count);
+    if (pending)
+        free(pending);
+}
+
+static void store_put(const char *name, const void *head, size_t head_size, const void *data, size_t size)
+{   // stores head followed by data under name
+    char fname[PATH_MAX], tmp_name[PATH_MAX + 32];
+    struct stat st;
+    STORE_ENTRY e;
+    e.key = fnv1a(name, strlen(name), FNV_OFFSET), e.hash = fnv1a(data, size, fnv1a(head, head_size, FNV_OFFSET));
+    e.size = head_size + size, e.used = time(NULL);
+    store_object_path(fname, e.hash);
+    if (stat(fname, &st) || (size_t)st.st_size != head_size + size)
+    {   // objects only ever appear complete
+        snprintf(tmp_name, sizeof(tmp_name), "%s.%d.%lx", fname, (int)getpid(), (unsigned long)(size_t)data);
+        mkpath(tmp_name);
+        FILE *f = fopen(tmp_name, "wb");
+        if (!f)
+            return;
+        int ok = (!head_size || fwrite(head, 1, head_size, f) == head_size) && fwrite(data, 1, size, f) == size;
+        ok = !fclose(f) && ok;
+        if (!ok || rename(tmp_name, fname))
+        {
+            remove(tmp_name);
+            return;
+        }
+    }
+    STORE_ENTRY *full = 0;
+    pthread_mutex_lock(&_store.pending_lock);
+    int batched = 0 != _store.pending;
+    if (batched)
+    {
+        _store.pending[_store.num_pending++] = e;
+        if (STORE_BATCH == _store.num_pending)
+        {
+            full = _store.pending;
+            _store.pending = (STORE_ENTRY *)malloc(STORE_BATCH*sizeof(STORE_ENTRY));
+            _store.num_pending = 0;
+        }
+    }
+    pthread_mutex_unlock(&_store.pending_lock);
+    if (full)
+    {
+        store_index_add(full, STORE_BATCH);
+        free(full);
+    }
+    if (!batched)
+        store_index_add(&e, 1);
+}
+
+static int codepoint_utf8(uint32_t codepoint, char **buf)
+{
+    int len = 0;
+    char *p = *buf;
+    if (codepoint >= 0x110000u)
+        return 0;
+    if (codepoint < 0x80u)
+    {
+        p[len++] = (char)codepoint;
+    } else if (codepoint < 0x800u)
+    {
+        p[len++] = (char)(0xC0 | codepoint >> 6 & 0x1F);
+        p[len++] = (char)(0x80 | codepoint & 0x3F);
+    } else if (codepoint < 0x10000u)
+    {
+        p[len++] = (char)(0xE0 | codepoint >> 12 & 0xF);
+        p[len++] = (char)(0x80 | codepoint >> 6 & 0x3F);
+        p[len++] = (char)(0x80 | codepoint & 0x3F);
+    } else
+    {
+        p[len++] = (char)(0xF0 | codepoint >> 18 & 0x7);
+        p[len++] = (char)(0x80 | codepoint >> 12 & 0x3F);
+        p[len++] = (char)(0x80 | codepoint >> 6 & 0x3F);
+        p[len++] = (char)(0x80 | codepoint & 0x3F);
+    }
+    return len;
+}
+
+static int unescape_json(char *buf, int buf_len, char *out_buf)
+{
+    enum {
+        JSON_INITIAL,
+        JSON_ESCAPE,
+        JSON_UNICODE,
+        JSON_UTF16_I1,
+        JSON_UTF16_I2,
+        JSON_UTF16_LS
+    };
+    int i, ubuf_offset, len = 0, state = JSON_INITIAL;
+    uint32_t u1, codepoint;
+    char ch, *p = out_buf, *pt;
+    char ubuf[5];
+    ubuf[4] = 0;
+    for (i = 0; i < buf_len && buf[i]; i++) // jfes sizes count the terminator
+    {
+        ch = buf[i];
+        if (state == JSON_INITIAL)
+        {
+            if (ch != '\\')
+                p[len++] = ch;
+            else
+                state = JSON_ESCAPE;
+        } else if (state == JSON_ESCAPE || state == JSON_UTF16_I2)
+        {
+            int old_state = state;
+            state = JSON_INITIAL;
+            switch(ch)
+            {
+                case 'n': p[len++] = '\n'; break;
+                case 't': p[len++] = '\t'; break;
+                case 'r': p[len++] = '\r'; break;
+                case 'b': p[len++] = '\b'; break;
+                case 'f': p[len++] = '\f'; break;
+                case 'u': state = (JSON_ESCAPE == old_state) ? JSON_UNICODE : JSON_UTF16_LS; ubuf_offset = 0; break;
+                default: p[len++] = ch; break;
+            }
+        } else if (state == JSON_UNICODE)
+        {
+            ubuf[ubuf_offset++] = ch;
+            if (ubuf_offset == 4)
+            {
+                codepoint = strtol(ubuf, NULL, 16);
+                if ((codepoint & 0xFC00u) == 0xD800u)
+                {
+                    u1 = codepoint;
+                    state = JSON_UTF16_I1;
+                } else
+                {
+                    pt = &p[len];
+                    len += codepoint_utf8(codepoint, &pt);
+                    state = JSON_INITIAL;
+                }
+            }
+        } else if (state == JSON_UTF16_I1)
+        {
+            if (ch != '\\')
+            {
+                p[len++] = ch;
+                state = JSON_INITIAL;
+            } else
+                state = JSON_UTF16_I2;
+        } else if (state == JSON_UTF16_LS)
+        {
+            ubuf[ubuf_offset++] = ch;
+            if (ubuf_offset == 4)
+            {
+                codepoint = strtol(ubuf, NULL, 16);
+                if ((codepoint & 0xFC00u) == 0xDC00u)
+                    codepoint = ((u1 & 0x3FFu) << 10 | codepoint & 0x3FFu) + 0x10000u;
+                pt = &p[len];
+                len += codepoint_utf8(codepoint, &pt);
+                state = JSON_INITIAL;
+            }
+        }
+    }
+    p[len] = 0;
+    return len;
+}
+
+#ifdef _DEBUG
+GL_DEBUG_TLS int gl_debug_pending, gl_debug_line;
+GL_DEBUG_TLS const char *gl_debug_file, *gl_debug_func;
+static GL_DEBUG_TLS int gl_debug_callback_installed, gl_debug_count;
+static GL_DEBUG_TLS char gl_debug_msg[512];
+
+static void APIENTRY gl_debug_cb(GLenum source, GLenum type, GLuint id, GLenum severity, GLsizei length, const GLchar *message, const void *user)
+{   // synchronous output, so this runs inside the offending call and the next GLCHK reports it
+    if (GL_DEBUG_TYPE_ERROR != type || GL_DEBUG_SOURCE_SHADER_COMPILER == source)
+        return; // performance hints, compiler logs are checked after each compile
+    if (!gl_debug_count++)
+        snprintf(gl_debug_msg, sizeof(gl_debug_msg), "%s", message);
+    gl_debug_pending = 1;
+}
+
+static void gl_debug_init()
+{
+    if (!GLAD_GL_KHR_debug)
+        return;
+    glEnable(GL_DEBUG_OUTPUT);
+    glEnable(GL_DEBUG_OUTPUT_SYNCHRONOUS);
+    glDebugMessageControl(GL_DONT_CARE, GL_DONT_CARE, GL_DEBUG_SEVERITY_NOTIFICATION, 0, NULL, GL_FALSE);
+    glDebugMessageCallback(gl_debug_cb, NULL);
+    gl_debug_callback_installed = 1;
+}
+
+void CheckGLErrors(const char *file, const char *func, int line)
+{
+    if (gl_debug_count > 1)
+        printf("OpenGL error in %s (%s:%i): %s (+%d more)\n", func, file, line, gl_debug_msg, gl_debug_count - 1);
+    else
+        printf("OpenGL error in %s (%s:%i): %s\n", func, file, line, gl_debug_msg);
+    fflush(stdout);
+    gl_debug_pending = gl_debug_count = 0;
+}
+
+void CheckGLFrameErrors()
+{
+    if (gl_debug_callback_installed)
+        return;
+    for (int i = 0, err; i < 8 && (err = glGetError()); i++)
+    {
+        printf("OpenGL error during frame: err=0x%x, last checked in %s (%s:%i)\n", err, gl_debug_func, gl_debug_file, gl_debug_line);
+        fflush(stdout);
+    }
+}
+#endif
+
+#ifdef HAVE_EGL
+static EGLContext egl_create_context(EGLContext share)
+{
+    static const EGLint context_attribs[] = {
+        EGL_CONTEXT_MAJOR_VERSION, 3,
+        EGL_CONTEXT_MINOR_VERSION, 3,
+        EGL_CONTEXT_OPENGL_PROFILE_MASK, EGL_CONTEXT_OPENGL_CORE_PROFILE_BIT,
+#ifdef _DEBUG
+        EGL_CONTEXT_OPENGL_DEBUG, EGL_TRUE,
+#endif
+        EGL_NONE
+    };
+    EGLContext ctx = eglCreateContext(_eglDisplay, _eglConfig, share, context_attribs);
+    if (EGL_NO_CONTEXT == ctx) // no core profile, legacy context
+        ctx = eglCreateContext(_eglDisplay, _eglConfig, share, context_attribs + 6);
+    return ctx;
+}
+
+static void egl_init()
+{
+    PFNEGLGETPLATFORMDISPLAYEXTPROC getPlatformDisplay = (PFNEGLGETPLATFORMDISPLAYEXTPROC)eglGetProcAddress("eglGetPlatformDisplayEXT");
+    if (getPlatformDisplay)
+        _eglDisplay = getPlatformDisplay(EGL_PLATFORM_SURFACELESS_MESA, EGL_DEFAULT_DISPLAY, NULL);
+    if (EGL_NO_DISPLAY == _eglDisplay)
+        _eglDisplay = eglGetDisplay(EGL_DEFAULT_DISPLAY);
+    if (EGL_NO_DISPLAY == _eglDisplay || !eglInitialize(_eglDisplay, NULL, NULL) || !eglBindAPI(EGL_OPENGL_API))
+    {
+        printf("error: egl init failed (0x%x)\n", eglGetError());
+        exit(1);
+    }
+    static const EGLint config_attribs[] = {
+        EGL_SURFACE_TYPE, EGL_PBUFFER_BIT,
+        EGL_RENDERABLE_TYPE, EGL_OPENGL_BIT,
+        EGL_RED_SIZE, 8, EGL_GREEN_SIZE, 8, EGL_BLUE_SIZE, 8, EGL_ALPHA_SIZE, 8,
+        EGL_NONE
+    };
+    static const EGLint pbuffer_attribs[] = { EGL_WIDTH, 1, EGL_HEIGHT, 1, EGL_NONE };
+    EGLConfig config = EGL_NO_CONFIG_KHR;
+    EGLint num_configs = 0;
+    // rendering always goes to an FBO, the pbuffer (if any) only keeps drivers without surfaceless contexts happy
+    if (eglChooseConfig(_eglDisplay, config_attribs, &config, 1, &num_configs) && num_configs)
+        _eglSurface = eglCreatePbufferSurface(_eglDisplay, config, pbuffer_attribs);
+    else
+        config = EGL_NO_CONFIG_KHR;
+    _eglConfig = config;
+    _eglContext = egl_create_context(EGL_NO_CONTEXT);
+    if (EGL_NO_CONTEXT == _eglContext || !eglMakeCurrent(_eglDisplay, _eglSurface, _eglSurface, _eglContext))
+    {
+        printf("error: egl create context failed (0x%x)\n", eglGetError());
+        exit(1);
+    }
+    gladLoadGLLoader((GLADloadproc)eglGetProcAddress);
+}
+
+static void egl_close()
+{
+    eglMakeCurrent(_eglDisplay, EGL_NO_SURFACE, EGL_NO_SURFACE, EGL_NO_CONTEXT);
+    eglDestroyContext(_eglDisplay, _eglContext);
+    if (EGL_NO_SURFACE != _eglSurface)
+        eglDestroySurface(_eglDisplay, _eglSurface);
+    eglTerminate(_eglDisplay);
+}
+#endif
+
+static double get_time()
+{
+    if (_mainWindow)
+        return glfwGetTime();
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec*1e-9;
+}
+
+static void draw_init()
+{
+    if (GLVersion.major < 3)
+        return; // legacy context, passes are drawn with glRecti
+    GLint isCompiled = 0;
+    _vertexShader = glCreateShader(GL_VERTEX_SHADER); GLCHK;
+    glShaderSource(_vertexShader, 1, &vertex_shader, 0); GLCHK;
+    glCompileShader(_vertexShader); GLCHK;
+    glGetShaderiv(_vertexShader, GL_COMPILE_STATUS, &isCompiled); GLCHK;
+    if (isCompiled == GL_FALSE)
+    {
+        char errorLog[1024];
+        glGetShaderInfoLog(_vertexShader, sizeof(errorLog), NULL, errorLog); GLCHK;
+        printf("vertex shader compile error: %s", errorLog);
+        exit(1);
+    }
+    // core profiles need a bound vertex array even though the triangle comes from gl_VertexID
+    glGenVertexArrays(1, &_fullscreenVao); GLCHK;
+    glBindVertexArray(_fullscreenVao); GLCHK;
+}
+
+static void gl_init(int width, int height, int headless)
+{
+    if (headless)
+    {
+#ifdef HAVE_EGL
+        egl_init();
+#else
+        printf("error: headless mode requires EGL support\n");
+        exit(1);
+#endif
+    } else
+    {
+        if (!glfwInit())
+        {
+            printf("error: glfw init failed\n");
+            exit(1);
+        }
+        glfwWindowHint(GLFW_CONTEXT_VERSION_MAJOR, 3);
+        glfwWindowHint(GLFW_CONTEXT_VERSION_MINOR, 3);
+        glfwWindowHint(GLFW_OPENGL_PROFILE, GLFW_OPENGL_CORE_PROFILE);
+        glfwWindowHint(GLFW_OPENGL_FORWARD_COMPAT, GL_TRUE);
+        glfwWindowHint(GLFW_RESIZABLE, 1);
+#ifdef _DEBUG
+        glfwWindowHint(GLFW_OPENGL_DEBUG_CONTEXT, 1);
+#endif
+        _mainWindow = glfwCreateWindow(width, height, "Shadertoy", NULL, NULL);
+#ifndef USE_GLES3
+        if (!_mainWindow)
+        {   // no core profile, fall back to a legacy context
+            glfwWindowHint(GLFW_CONTEXT_VERSION_MAJOR, 2);
+            glfwWindowHint(GLFW_CONTEXT_VERSION_MINOR, 0);
+            glfwWindowHint(GLFW_OPENGL_PROFILE, GLFW_OPENGL_ANY_PROFILE);
+            glfwWindowHint(GLFW_OPENGL_FORWARD_COMPAT, GL_FALSE);
+            _mainWindow = glfwCreateWindow(width, height, "Shadertoy", NULL, NULL);
+        }
+#endif
+        if (!_mainWindow)
+        {
+            printf("error: create window failed\n"); fflush(stdout);
+            exit(1);
+        }
+        glfwMakeContextCurrent(_mainWindow);
+        glfwSetInputMode(_mainWindow, GLFW_STICKY_MOUSE_BUTTONS, 1);
+
+        gladLoadGL();
+    }
+#ifdef _DEBUG
+    gl_debug_init();
+#endif
+    if (GLAD_GL_KHR_parallel_shader_compile)
+    {
+        glMaxShaderCompilerThreadsKHR(0xFFFFFFFF); GLCHK;
+    } else if (GLAD_GL_ARB_parallel_shader_compile)
+    {
+        glMaxShaderCompilerThreadsARB(0xFFFFFFFF); GLCHK;
+    }
+    draw_init();
+}
+
+static void gl_close()
+{
+    if (!_mainWindow)
+    {
+#ifdef HAVE_EGL
+        egl_close();
+#endif
+        return;
+    }
+    glfwDestroyWindow(_mainWindow);
+    glfwTerminate();
+}
+
+// second context sharing objects with the main one, background loads compile and upload on it
+static GLFWwindow *_workerWindow;
+#ifdef HAVE_EGL
+static EGLSurface _eglWorkerSurface = EGL_NO_SURFACE;
+static EGLContext _eglWorkerContext = EGL_NO_CONTEXT;
+#endif
+
+static int gl_worker_init()
+{   // main thread only, glfw creates windows there
+    if (_workerWindow)
+        return 1;
+#ifdef HAVE_EGL
+    if (EGL_NO_CONTEXT != _eglWorkerContext)
+        return 1;
+    if (!_mainWindow)
+    {
+        static const EGLint pbuffer_attribs[] = { EGL_WIDTH, 1, EGL_HEIGHT, 1, EGL_NONE };
+        _eglWorkerContext = egl_create_context(_eglContext);
+        if (EGL_NO_CONTEXT == _eglWorkerContext)
+            return 0;
+        if (EGL_NO_SURFACE != _eglSurface)
+            _eglWorkerSurface = eglCreatePbufferSurface(_eglDisplay, _eglConfig, pbuffer_attribs);
+        return 1;
+    }
+#endif
+    if (!_mainWindow)
+        return 0;
+    glfwWindowHint(GLFW_VISIBLE, 0);
+    _workerWindow = glfwCreateWindow(1, 1, "", NULL, _mainWindow);
+    return 0 != _workerWindow;
+}
+
+static void gl_worker_bind(int bind)
+{   // worker thread
+    if (_workerWindow)
+    {
+        glfwMakeContextCurrent(bind ? _workerWindow : NULL);
+        return;
+    }
+#ifdef HAVE_EGL
+    if (bind)
+    {
+        eglBindAPI(EGL_OPENGL_API); // per thread state
+        eglMakeCurrent(_eglDisplay, _eglWorkerSurface, _eglWorkerSurface, _eglWorkerContext);
+    } else
+        eglMakeCurrent(_eglDisplay, EGL_NO_SURFACE, EGL_NO_SURFACE, EGL_NO_CONTEXT);
+#endif
+}
+
+static void gl_worker_close()
+{
+    if (_workerWindow)
+        glfwDestroyWindow(_workerWindow);
+    _workerWindow = 0;
+#ifdef HAVE_EGL
+    if (EGL_NO_CONTEXT != _eglWorkerContext)
+        eglDestroyContext(_eglDisplay, _eglWorkerContext);
+    if (EGL_NO_SURFACE != _eglWorkerSurface)
+        eglDestroySurface(_eglDisplay, _eglWorkerSurface);
+    _eglWorkerContext = EGL_NO_CONTEXT, _eglWorkerSurface = EGL_NO_SURFACE;
+#endif
+}
+
+static const char *abs_path(const char *path, char *buf)
+{
+    size_t len;
+    if ('/' == path[0] || !getcwd(buf, PATH_MAX))
+        return path;
+    len = strlen(buf);
+    snprintf(buf + len, PATH_MAX - len, "/%s", path);
+    return buf;
+}
+
+static int output_name(char *buf, size_t size, const char *pattern, int frame)
+{   // only %d or %0Nd for the frame number and %%, the pattern is user input. -1 when invalid, else the number of frame fields
+    int fields = 0;
+    size_t len = 0;
+    for (const char *c = pattern; *c && len + 1 < size; c++)
+    {
+        if ('%' != *c || '%' == c[1])
+        {
+            buf[len++] = *c;
+            c += '%' == *c;
+            continue;
+        }
+        int zero = '0' == c[1], width = 0;
+        for (c += 1 + zero; *c >= '0' && *c <= '9' && width < 32; c++)
+            width = width*10 + *c - '0';
+        if ('d' != *c || fields++)
+            return -1;
+        len += snprintf(buf + len, size - len, zero ? "%0*d" : "%*d", width, frame);
+        if (len >= size)
+            return -1;
+    }
+    buf[len] = 0;
+    return fields;
+}
+
+static void save_ppm(const char *fname, int width, int height)
+{
+    unsigned char *pix = (unsigned char *)malloc(width*height*4);
+    FILE *f = fopen(fname, "wb");
+    if (!pix || !f)
+    {
+        printf("error: writing %s failed\n", fname);
+        goto fail;
+    }
+    glPixelStorei(GL_PACK_ALIGNMENT, 1); GLCHK;
+    glReadPixels(0, 0, width, height, GL_RGBA, GL_UNSIGNED_BYTE, pix); GLCHK;
+    fprintf(f, "P6\n%d %d\n255\n", width, height);
+    for (int y = height - 1; y >= 0; y--)
+        for (int x = 0; x < width; x++)
+            fwrite(pix + (y*width + x)*4, 1, 3, f);
+fail:
+    if (f)
+        fclose(f);
+    if (pix)
+        free(pix);
+}
+
+static void sampler_params(const SAMPLER *s, int is_cubemap, int has_mipmaps, GLint *params)
+{   // min filter, mag filter, wrap
+    int clamp = GL_CLAMP_TO_EDGE, min_filter = has_mipmaps ? GL_LINEAR_MIPMAP_LINEAR : GL_LINEAR, mag_filter = GL_LINEAR;
+    if (s)
+    {
+        clamp = (s->wrap && !is_cubemap) ? GL_REPEAT : GL_CLAMP_TO_EDGE;
+        if (!s->filter)
+        {
+            min_filter = GL_NEAREST;
+            mag_filter = GL_NEAREST;
+        } else if (1 == s->filter)
+            min_filter = GL_LINEAR;
+    }
+    params[0] = min_filter, params[1] = mag_filter, params[2] = clamp;
+}
+
+static void set_sampler(int tgt, const SAMPLER *s, int is_cubemap, int has_mipmaps)
+{
+    GLint params[3];
+    sampler_params(s, is_cubemap, has_mipmaps, params);
+    glTexParameteri(tgt, GL_TEXTURE_MIN_FILTER, params[0]); GLCHK;
+    glTexParameteri(tgt, GL_TEXTURE_MAG_FILTER, params[1]); GLCHK;
+    glTexParameteri(tgt, GL_TEXTURE_WRAP_S, params[2]); GLCHK;
+    glTexParameteri(tgt, GL_TEXTURE_WRAP_T, params[2]); GLCHK;
+}
+
+static int sampler_objects_supported()
+{
+    return GLVersion.major > 3 || (3 == GLVersion.major && GLVersion.minor >= 3) || GLAD_GL_ARB_sampler_objects;
+}
+
+static GLuint buffer_sampler(SHADER_INPUT *inp)
+{   // readers of one buffer share its texture, each keeps its filter and wrap in a sampler object
+    GLint params[3];
+    if (inp->sampler_object)
+        return inp->sampler_object;
+    sampler_params(&inp->sampler, 0, 0, params);
+    glGenSamplers(1, &inp->sampler_object); GLCHK;
+    glSamplerParameteri(inp->sampler_object, GL_TEXTURE_MIN_FILTER, params[0]); GLCHK;
+    glSamplerParameteri(inp->sampler_object, GL_TEXTURE_MAG_FILTER, params[1]); GLCHK;
+    glSamplerParameteri(inp->sampler_object, GL_TEXTURE_WRAP_S, params[2]); GLCHK;
+    glSamplerParameteri(inp->sampler_object, GL_TEXTURE_WRAP_T, params[2]); GLCHK;
+    return inp->sampler_object;
+}
+
+static void texture_create(SHADER_INPUT *inp, int w, int h)
+{   // every level is allocated once, texture_face() fills level 0
+    int tgt = inp->is_cubemap ? GL_TEXTURE_CUBE_MAP : GL_TEXTURE_2D, levels = 1;
+    while ((w | h) >> levels)
+        levels++;
+    inp->w = w, inp->h = h;
+    glGenTextures(1, &inp->tex); GLCHK;
+    glBindTexture(tgt, inp->tex); GLCHK;
+    set_sampler(tgt, &inp->sampler, inp->is_cubemap, 1);
+    if (glTexStorage2D)
+    {
+        glTexStorage2D(tgt, levels, GL_RGBA8, w, h); GLCHK;
+        return;
+    }
+    for (int i = 0; i < (inp->is_cubemap ? 6 : 1); i++)
+    {
+        glTexImage2D(inp->is_cubemap ? GL_TEXTURE_CUBE_MAP_POSITIVE_X + i : GL_TEXTURE_2D, 0, GL_RGBA8, w, h, 0, GL_RGBA, GL_UNSIGNED_BYTE, 0); GLCHK;
+    }
+    if (!glGenerateMipmap)
+        glTexParameteri(tgt, GL_GENERATE_MIPMAP, GL_TRUE); GLCHK; // legacy, rebuilt per face on upload
+}
+
+static void texture_face(SHADER_INPUT *inp, int face, const unsigned char *pix)
+{   // pix is an offset when a pixel unpack buffer is bound
+    int tgt = inp->is_cubemap ? GL_TEXTURE_CUBE_MAP_POSITIVE_X + face : GL_TEXTURE_2D;
+    glTexSubImage2D(tgt, 0, 0, 0, inp->w, inp->h, GL_RGBA, GL_UNSIGNED_BYTE, pix); GLCHK;
+}
+
+static void texture_finish(SHADER_INPUT *inp)
+{
+    int tgt = inp->is_cubemap ? GL_TEXTURE_CUBE_MAP : GL_TEXTURE_2D;
+    if (glGenerateMipmap)
+        glGenerateMipmap(tgt); GLCHK;
+    glBindTexture(tgt, 0); GLCHK;
+}
+
+void fb_delete(FBO *f)
+{
+    if (f->framebuffer)
+        glDeleteFramebuffers(1, &f->framebuffer); GLCHK;
+    if (f->framebufferTex)
+        glDeleteTextures(1, &f->framebufferTex); GLCHK;
+    f->framebuffer = f->framebufferTex = 0;
+}
+
+static int fb_supported()
+{   // the legacy 2.0 fallback may have no framebuffer objects, their gl pointers are 0 then
+    return GLVersion.major >= 3 || GLAD_GL_ARB_framebuffer_object;
+}
+
+void fb_init(FBO *f, int width, int height, int float_tex)
+{
+    f->floatTex = float_tex && (GLVersion.major >= 3 || (GLAD_GL_ARB_texture_float && GLAD_GL_ARB_half_float_pixel));
+    f->width = width, f->height = height;
+    glGenFramebuffers(1, &f->framebuffer); GLCHK;
+    glBindFramebuffer(GL_FRAMEBUFFER, f->framebuffer); GLCHK;
+    glGenTextures(1, &f->framebufferTex); GLCHK;
+    glBindTexture(GL_TEXTURE_2D, f->framebufferTex); GLCHK;
+    if (f->floatTex)
+        glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA16F, width, height, 0, GL_RGBA, GL_HALF_FLOAT, 0);
+    else
+        glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA, width, height, 0, GL_RGBA, GL_UNSIGNED_BYTE, 0);
+    GLCHK;
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR); GLCHK;
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR); GLCHK;
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE); GLCHK;
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE); GLCHK;
+    glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D, f->framebufferTex, 0); GLCHK;
+    glClearColor(0.0f, 0.0f, 0.0f, 0.0f); GLCHK;
+    glClear(GL_COLOR_BUFFER_BIT); GLCHK;
+    glBindTexture(GL_TEXTURE_2D, 0); GLCHK;
+    glBindFramebuffer(GL_FRAMEBUFFER, 0); GLCHK;
+}
+
+void shader_delete(SHADER *s)
+{
+    for (int i = 0; i < 4; i++)
+        if (s->inputs[i].id)
+            free((char *)s->inputs[i].id);
+    if (s->output[0].id)
+        free((char *)s->output[0].id);
+    if (s->shader)
+        glDeleteShader(s->shader);
+    if (s->prog)
+        glDeleteProgram(s->prog);
+    fb_delete(&s->output[0]);
+    fb_delete(&s->output[1]);
+}
+
+static uint64_t program_key(const GLchar **source, const GLint *lengths, int count, uint64_t common_hash)
+{   // binaries are only valid for the exact source on the exact driver
+    static const GLenum ident[] = { GL_VENDOR, GL_RENDERER, GL_VERSION };
+    uint64_t h = FNV_OFFSET;
+    for (int i = 0; i < count; i++) // the same key as the joined source
+        h = fnv1a(source[i], lengths[i], h);
+    h = fnv1a("", 1, h);
+    h = fnv1a(&common_hash, sizeof(common_hash), h);
+    if (_vertexShader)
+        h = fnv1a(vertex_shader, strlen(vertex_shader) + 1, h);
+    for (int i = 0; i < 3; i++)
+    {
+        const char *str = (const char *)glGetString(ident[i]); GLCHK;
+        if (str)
+            h = fnv1a(str, strlen(str) + 1, h);
+    }
+    return h;
+}
+
+static int program_cache_supported()
+{
+    static int supported = -1;
+    if (supported < 0)
+    {
+        GLint formats = 0;
+        if (glProgramBinary && glGetProgramBinary)
+            glGetIntegerv(GL_NUM_PROGRAM_BINARY_FORMATS, &formats); GLCHK;
+        supported = formats > 0;
+    }
+    return supported;
+}
+
+static int program_cache_load(GLuint prog, uint64_t key)
+{
+    char name[64];
+    int size;
+    GLint isLinked = 0;
+    snprintf(name, sizeof(name), "program/%016llx", (unsigned long long)key);
+    unsigned char *data = store_get(name, &size);
+    if (!data)
+        return 0;
+    if (size > 8 && !memcmp(data, "TOYP", 4))
+    {
+        GLenum format;
+        memcpy(&format, data + 4, sizeof(format));
+        glProgramBinary(prog, format, data + 8, size - 8); GLCHK;
+        glGetProgramiv(prog, GL_LINK_STATUS, &isLinked); GLCHK;
+    }
+    free(data);
+    return isLinked;
+}
+
+static void program_cache_save(GLuint prog, uint64_t key)
+{
+    char name[64], head[8];
+    GLint length = 0;
+    GLenum format = 0;
+    glGetProgramiv(prog, GL_PROGRAM_BINARY_LENGTH, &length); GLCHK;
+    if (length <= 0)
+        return;
+    unsigned char *data = (unsigned char *)malloc(length);
+    if (!data)
+        return;
+    glGetProgramBinary(prog, length, &length, &format, data); GLCHK;
+    memcpy(head, "TOYP", 4);
+    memcpy(head + 4, &format, sizeof(format));
+    snprintf(name, sizeof(name), "program/%016llx", (unsigned long long)key);
+    store_put(name, head, sizeof(head), data, length);
+    free(data);
+}
+
+#define TEXTURE_HEADER_SIZE 16
+
+static uint64_t texture_key(ASSET *a)
+{   // decoding is deterministic, only the source bytes and the flip matter
+    int vflip = a->inp->sampler.vflip;
+    uint64_t h = fnv1a(a->data, a->size, FNV_OFFSET);
+    return fnv1a(&vflip, sizeof(vflip), h);
+}
+
+static void image_free(ASSET *a)
+{
+    if (a->map)
+#ifndef __MINGW32__
+        munmap(a->map, a->map_size);
+#else
+        free(a->map);
+#endif
+    else if (a->pix)
+        stbi_image_free(a->pix);
+    a->pix = 0, a->map = 0;
+}
+
+static int texture_cache_load(ASSET *a, uint64_t key)
+{   // "TOYT", width, height, 0 then RGBA rows, hits are mapped instead of decoded
+    char name[64];
+    uint32_t hdr[4];
+    unsigned char *map;
+    size_t size = 0;
+    snprintf(name, sizeof(name), "texture/%016llx", (unsigned long long)key);
+#ifndef __MINGW32__
+    map = (unsigned char *)store_map(name, &size);
+#else
+    int len;
+    map = store_get(name, &len);
+    size = len;
+#endif
+    if (!map)
+        return 0;
+    a->map = map, a->map_size = size;
+    if (size >= sizeof(hdr))
+        memcpy(hdr, map, sizeof(hdr));
+    if (size < sizeof(hdr) || memcmp(hdr, "TOYT", 4) || size != TEXTURE_HEADER_SIZE + (size_t)hdr[1]*hdr[2]*4)
+    {
+        image_free(a);
+        return 0;
+    }
+    a->pix = map + TEXTURE_HEADER_SIZE, a->w = hdr[1], a->h = hdr[2];
+    return 1;
+}
+
+static void texture_cache_save(ASSET *a, uint64_t key)
+{
+    char name[64];
+    uint32_t hdr[4] = { 0, a->w, a->h, 0 };
+    memcpy(hdr, "TOYT", 4);
+    snprintf(name, sizeof(name), "texture/%016llx", (unsigned long long)key);
+    store_put(name, hdr, sizeof(hdr), a->pix, (size_t)a->w*a->h*4);
+}
+
+static void image_decode(ASSET *a)
+{   // any thread, stbi's global flip flag is not thread safe so the rows are flipped here
+    int n;
+    uint64_t key = 0;
+    if (a->data)
+    {
+        key = texture_key(a);
+        int hit = texture_cache_load(a, key);
+        if (!hit)
+            a->pix = stbi_load_from_memory((const stbi_uc *)a->data, a->size, &a->w, &a->h, &n, 4);
+        free(a->data);
+        a->data = 0;
+        if (hit)
+            return; // stored flipped
+    }
+    if (a->pix && a->inp->sampler.vflip)
+    {
+        size_t stride = (size_t)a->w*4;
+        unsigned char *row = (unsigned char *)malloc(stride);
+        for (int y = 0; row && y < a->h/2; y++)
+        {
+            unsigned char *top = a->pix + y*stride, *bottom = a->pix + (a->h - 1 - y)*stride;
+            memcpy(row, top, stride);
+            memcpy(top, bottom, stride);
+            memcpy(bottom, row, stride);
+        }
+        free(row);
+    }
+    if (a->pix)
+        texture_cache_save(a, key);
+}
+
+static void shader_uniforms(SHADER *s)
+{
+    s->iResolution = glGetUniformLocation(s->prog, "iResolution"); GLCHK;
+    s->iTime       = glGetUniformLocation(s->prog, "iTime"); GLCHK;
+    s->iTimeDelta  = glGetUniformLocation(s->prog, "iTimeDelta"); GLCHK;
+    s->iFrame      = glGetUniformLocation(s->prog, "iFrame"); GLCHK;
+    s->iMouse      = glGetUniformLocation(s->prog, "iMouse"); GLCHK;
+    s->iDate       = glGetUniformLocation(s->prog, "iDate"); GLCHK;
+    s->iSampleRate = glGetUniformLocation(s->prog, "iSampleRate"); GLCHK;
+    for (int i = 0; i < 4; i++)
+    {
+        char buf[64];
+        sprintf(buf, "iChannel%d", i);
+        s->iChannel[i] = glGetUniformLocation(s->prog, buf); GLCHK;
+        sprintf(buf, "iChannelTime[%d]", i);
+        s->iChannelTime[i] = glGetUniformLocation(s->prog, buf); GLCHK;
+        sprintf(buf, "iChannelResolution[%d]", i);
+        s->iChannelResolution[i] = glGetUniformLocation(s->prog, buf); GLCHK;
+    }
+}
+
+// Reduces common code to what every pass has to see as text: preprocessor lines, types,
+// globals and prototypes of its functions. The bodies are compiled once in the common object.
+static char *common_declarations(const char *src)
+{
+    size_t len = strlen(src), out_len = 0;
+    char *out = (char *)malloc(len + 2);
+    const char *p = src, *stmt = src, *line = src;
+    int depth = 0, in_function = 0, line_start = 1;
+    char last = 0;
+    #define EMIT(from, to) do { memcpy(out + out_len, from, (to) - (from)); out_len += (to) - (from); } while (0)
+    while (*p)
+    {
+        if ('/' == p[0] && '/' == p[1])
+        {
+            while (*p && '\n' != *p)
+                p++;
+            continue;
+        }
+        if ('/' == p[0] && '*' == p[1])
+        {
+            const char *end = strstr(p + 2, "*/");
+            p = end ? end + 2 : p + strlen(p);
+            continue;
+        }
+        char c = *p;
+        if (!depth && line_start && '#' == c)
+        {   // directive, copied whole with its continuation lines
+            while (*p && ('\n' != *p || '\\' == p[-1]))
+                p++;
+            EMIT(stmt, p);
+            stmt = p;
+            continue;
+        }
+        if (in_function && line_start && '#' == c)
+        {   // directives are not scoped by braces, a #define in a body is seen by the passes too
+            while (*p && ('\n' != *p || '\\' == p[-1]))
+                p++;
+            if (*p)
+                p++;
+            EMIT(line, p); // with the newlines around it, the prototype before has none
+            line = p;
+            continue;
+        }
+        if ('\n' == c)
+            line_start = 1, line = p;
+        else if (' ' != c && '\t' != c && '\r' != c)
+            line_start = 0;
+        if (depth)
+        {
+            if ('{' == c)
+                depth++;
+            else if ('}' == c && !--depth && in_function)
+            {
+                stmt = p + 1;
+                in_function = 0;
+                last = 0;
+            }
+        } else if (';' == c)
+        {
+            EMIT(stmt, p + 1);
+            stmt = p + 1;
+            last = 0;
+        } else if ('{' == c)
+        {
+            depth = 1;
+            in_function = ')' == last;
+            if (in_function)
+            {   // "type name(args) {" becomes a prototype
+                EMIT(stmt, p);
+                EMIT(";", ";" + 1);
+            }
+        } else if (' ' != c && '\t' != c && '\r' != c && '\n' != c)
+            last = c;
+        p++;
+    }
+    if (!in_function)
+        EMIT(stmt, p);
+    #undef EMIT
+    out[out_len] = 0;
+    return out;
+}
+
+// Owned by the thread that compiles: the main thread at startup, before any reload thread
+// exists, then one reload thread at a time. reload_start() never runs two and pthread_create()
+// and pthread_join() order the hand-offs. The main context only sees the common shader through
+// programs it is attached to, those are shared objects.
+static struct
+{
+    pthread_t owner;
+    uint64_t hash;
+    char *decls;
+    GLuint shader;
+    int failed; // this common code does not compile on its own
+    int split; // the driver links two fragment shaders into one program: -1 untested, 0, 1
+} _common = { .split = -1 };
+
+static void common_claim()
+{
+    _common.owner = pthread_self();
+}
+
+static int common_split_probe()
+{   // a driver capability, tested once on shaders of our own so a broken pass can not decide it
+    static const char *probe[2] = {
+        "#version 300 es\n"
+        "precision highp float;\n"
+        "out vec4 fragmentColor;\n"
+        "float toy_probe(float x);\n"
+        "void main(void) { fragmentColor = vec4(toy_probe(1.0)); }\n",
+        "#version 300 es\n"
+        "precision highp float;\n"
+        "float toy_probe(float x) { return x*0.5; }\n"
+    };
+    GLint isLinked = 0;
+    GLuint prog = glCreateProgram(), sh[2]; GLCHK;
+    for (int i = 0; i < 2; i++)
+    {
+        sh[i] = glCreateShader(GL_FRAGMENT_SHADER); GLCHK;
+        glShaderSource(sh[i], 1, &probe[i], 0); GLCHK;
+        glCompileShader(sh[i]); GLCHK;
+        glAttachShader(prog, sh[i]); GLCHK;
+    }
+    if (_vertexShader)
+        glAttachShader(prog, _vertexShader); GLCHK;
+    glLinkProgram(prog); GLCHK;
+    glGetProgramiv(prog, GL_LINK_STATUS, &isLinked); GLCHK;
+    glDeleteProgram(prog); GLCHK;
+    for (int i = 0; i < 2; i++)
+        glDeleteShader(sh[i]); GLCHK;
+    return isLinked;
+}
+
+static const char *common_prepare(const char *pCommonCode)
+{
+    if (!pCommonCode || strstr(pCommonCode, "iChannel") || strstr(pCommonCode, "void main"))
+        return 0; // channel sampler types differ per pass, such code stays textual
+    assert(pthread_equal(_common.owner, pthread_self()));
+    if (_common.split < 0)
+        _common.split = common_split_probe();
+    if (!_common.split)
+        return 0;
+    uint64_t h = fnv1a(pCommonCode, strlen(pCommonCode) + 1, FNV_OFFSET);
+    if (!_common.decls || _common.hash != h)
+    {   // the state of the previous common code goes with it, a reload may have fixed it
+        if (_common.shader)
+            glDeleteShader(_common.shader); GLCHK;
+        if (_common.decls)
+            free(_common.decls);
+        _common.hash = h;
+        _common.decls = common_declarations(pCommonCode);
+        _common.shader = 0;
+        _common.failed = 0;
+    }
+    return _common.failed ? 0 : _common.decls; // kept across reloads
+}
+
+static GLuint common_shader(const char *pCommonCode)
+{
+    if (_common.shader)
+        return _common.shader;
+    const GLchar *sh[2] = { shader_header, pCommonCode };
+    _common.shader = glCreateShader(GL_FRAGMENT_SHADER); GLCHK;
+    glShaderSource(_common.shader, 2, sh, 0); GLCHK;
+    glCompileShader(_common.shader); GLCHK;
+    return _common.shader;
+}
+
+static void shader_release_common(SHADER *s)
+{
+    s->code = 0;
+    s->common = 0;
+}
+
+static int shader_compile_common(SHADER *s, const char *pCode, const char *pCommonCode, int split_common)
+{
+    char header[1024];
+    const char *common = pCommonCode, *decls = split_common ? common_prepare(pCommonCode) : 0;
+    int len = snprintf(header, sizeof(header), "%s", shader_header);
+    snprintf(header + len, sizeof(header) - len, shader_channels, s->inputs[0].is_cubemap ? "Cube" : "2D",
+        s->inputs[1].is_cubemap ? "Cube" : "2D", s->inputs[2].is_cubemap ? "Cube" : "2D", s->inputs[3].is_cubemap ? "Cube" : "2D");
+    if (decls)
+        common = decls;
+    int has_main = strstr(pCode, "void main(") || strstr(pCode, "void main ");
+    // the pieces go to the driver as they are, the pass code stays in the parsed json
+    const GLchar *sh[4] = { header, common ? common : "", pCode, has_main ? "" : shader_footer };
+    GLint lengths[4];
+    for (int i = 0; i < 4; i++)
+        lengths[i] = (GLint)strlen(sh[i]);
+
+    s->prog = glCreateProgram(); GLCHK;
+    s->shader = 0;
+    s->binary_key = 0;
+    if (program_cache_supported())
+    {
+        uint64_t key = program_key(sh, lengths, 4, decls ? _common.hash : 0);
+        if (program_cache_load(s->prog, key))
+            return 1;
+        s->binary_key = key;
+    }
+    // no status queries here, so the driver can keep compiling while other passes are issued
+    s->shader = glCreateShader(/*is_compute ? GL_COMPUTE_SHADER : */GL_FRAGMENT_SHADER); GLCHK;
+    glShaderSource(s->shader, 4, sh, lengths); GLCHK;
+    glCompileShader(s->shader); GLCHK;
+    glAttachShader(s->prog, s->shader); GLCHK;
+    if (decls)
+    {   // keep the sources in case the split program does not link
+        glAttachShader(s->prog, common_shader(pCommonCode)); GLCHK;
+        s->code = pCode;
+        s->common = pCommonCode;
+    }
+    if (_vertexShader)
+        glAttachShader(s->prog, _vertexShader); GLCHK;
+    if (s->binary_key)
+        glProgramParameteri(s->prog, GL_PROGRAM_BINARY_RETRIEVABLE_HINT, GL_TRUE); GLCHK;
+    glLinkProgram(s->prog); GLCHK;
+    return 1;
+}
+
+int shader_compile(SHADER *s, const char *pCode, const char *pCommonCode/*, int is_compute*/)
+{
+    return shader_compile_common(s, pCode, pCommonCode, 1);
+}
+
+int shader_ready(SHADER *s)
+{
+    GLint done = 1;
+    if (s->shader && (GLAD_GL_KHR_parallel_shader_compile || GLAD_GL_ARB_parallel_shader_compile))
+        glGetProgramiv(s->prog, GL_COMPLETION_STATUS_KHR, &done); GLCHK;
+    return done;
+}
+
+int shader_finish(SHADER *s)
+{
+    if (!s->shader)
+    {   // linked from the binary cache
+        shader_uniforms(s);
+        return 1;
+    }
+    if (s->common)
+    {
+        GLint isLinked = 0;
+        glGetProgramiv(s->prog, GL_LINK_STATUS, &isLinked); GLCHK;
+        if (!isLinked)
+        {   // common code that does not split cleanly, compile it into this pass as text
+            GLint isCompiled = 0;
+            assert(pthread_equal(_common.owner, pthread_self()));
+            glGetShaderiv(_common.shader, GL_COMPILE_STATUS, &isCompiled); GLCHK;
+            _common.failed = !isCompiled;
+            const char *code = s->code, *common = s->common;
+            shader_release_common(s);
+            glDeleteShader(s->shader); GLCHK;
+            glDeleteProgram(s->prog); GLCHK;
+            shader_compile_common(s, code, common, 0);
+            return shader_finish(s); // only this pass, the split itself links on this driver
+        }
+        shader_release_common(s);
+    }
+    GLint isLinked = 0;
+    glGetProgramiv(s->prog, GL_LINK_STATUS, &isLinked); GLCHK;
+#ifdef _DEBUG
+    GLint isCompiled = 0;
+    glGetShaderiv(s->shader, GL_COMPILE_STATUS, &isCompiled); GLCHK;
+    if (isCompiled == GL_FALSE)
+    {
+        GLint maxLength = 0;
+        glGetShaderiv(s->shader, GL_INFO_LOG_LENGTH, &maxLength); GLCHK;
+        GLchar *errorLog = (GLchar *)malloc(maxLength);
+        glGetShaderInfoLog(s->shader, maxLength, &maxLength, &errorLog[0]); GLCHK;
+        printf("compile error: %s", errorLog);
+        free(errorLog);
+        glGetShaderiv(s->shader, GL_SHADER_SOURCE_LENGTH, &maxLength); GLCHK;
+        GLchar *sh = (GLchar *)malloc(maxLength);
+        glGetShaderSource(s->shader, maxLength, &maxLength, sh); GLCHK;
+        printf("code: %s", sh);
+        free(sh);
+    } else if (isLinked == GL_FALSE)
+    {
+        GLint maxLength = 0;
+        glGetProgramiv(s->prog, GL_INFO_LOG_LENGTH, &maxLength); GLCHK;
+        GLchar *errorLog = (GLchar *)malloc(maxLength);
+        glGetProgramInfoLog(s->prog, maxLength, &maxLength, &errorLog[0]); GLCHK;
+        printf("link error: %s", errorLog);
+        free(errorLog);
+    }
+#endif
+    if (!isLinked)
+        return 0; // the caller decides, a failed reload keeps the running shader
+    if (s->binary_key)
+        program_cache_save(s->prog, s->binary_key);
+    shader_uniforms(s);
+    return 1;
+}
+
+int shader_init(SHADER *s, const char *pCode, const char *pCommonCode)
+{
+    return shader_compile(s, pCode, pCommonCode) && shader_finish(s);
+}
+
+int shaders_finish(SHADER **shaders, int count)
+{   // collect in completion order, with parallel compile the total is about the slowest pass
+    int remaining = count, errors = 0;
+    while (remaining)
+    {
+        int finished = 0;
+        for (int i = 0; i < count; i++)
+            if (shaders[i] && shader_ready(shaders[i]))
+            {
+                errors += !shader_finish(shaders[i]);
+                shaders[i] = 0;
+                remaining--, finished++;
+            }
+        if (!finished)
+        {
+            struct timespec ts = { 0, 1000000 };
+            nanosleep(&ts, NULL);
+        }
+    }
+    return errors;
+}
+
+void shadertoy_renderpass(SHADER *s, PLATFORM_PARAMS *p)
+{
+    glUseProgram(s->prog); GLCHK;
+    glUniform3f(s->iResolution, (float)p->winWidth, (float)p->winHeight, 1.0f); GLCHK;
+    glUniform1f(s->iTime, p->cur_time); GLCHK;
+    glUniform1f(s->iTimeDelta, p->cur_time - p->time_last); GLCHK;
+    glUniform1i(s->iFrame, p->frame); GLCHK;
+    if(p->cx > -0.5f)
+        glUniform4f(s->iMouse, p->mx, p->my, p->cx, p->cy); GLCHK;
+    glUniform4f(s->iDate, p->tm->tm_year, p->tm->tm_mon, p->tm->tm_mday, p->tm->tm_hour*3600 + p->tm->tm_min*60 + p->tm->tm_sec); GLCHK;
+    glUniform1f(s->iSampleRate, 0); GLCHK;
+
+    for (int i = 0; i < 4; i++)
+    {
+        SHADER_INPUT *inp = &s->inputs[i];
+        GLuint tex = inp->tex;
+        int w = inp->w, h = inp->h;
+        if (inp->buffer)
+        {   // previous frame for self-feedback and passes later in order, this frame otherwise
+            FBO *f = &inp->buffer->output[inp->buffer->output_idx];
+            tex = f->framebufferTex, w = f->width, h = f->height;
+        }
+        glUniform1f(s->iChannelTime[i], p->cur_time); GLCHK;
+        // a unit per channel even without a texture (still loading), sampler types cannot share one
+        int tgt = inp->is_cubemap ? GL_TEXTURE_CUBE_MAP : GL_TEXTURE_2D;
+        glActiveTexture(GL_TEXTURE0 + i); GLCHK;
+        glBindTexture(tgt, tex); GLCHK;
+        if (sampler_objects_supported())
+        {   // textures of assets carry their own parameters
+            glBindSampler(i, inp->buffer ? buffer_sampler(inp) : 0); GLCHK;
+        } else if (inp->buffer && tex)
+            set_sampler(tgt, &inp->sampler, 0, 0); // last reader wins on legacy contexts
+        glUniform1i(s->iChannel[i], i); GLCHK;
+        glUniform3f(s->iChannelResolution[i], w, h, 1.0f); GLCHK;
+    }
+    glActiveTexture(GL_TEXTURE0); GLCHK;
+
+    if (_fullscreenVao)
+    {
+        glDrawArrays(GL_TRIANGLES, 0, 3); GLCHK;
+    } else
+    {
+        glColor4f(0.0f, 0.0f, 0.0f, 1.0f); GLCHK;
+        glRecti(1, 1, -1, -1); GLCHK;
+    }
+    glUseProgram(0); GLCHK;
+}
+
+void shadertoy_render(SHADERTOY *t, PLATFORM_PARAMS *p)
+{
+    for (int i = 0; i < t->num_passes; i++)
+    {
+        SHADER *s = &t->shaders[t->order[i]];
+        if (PASS_BUFFER == s->type)
+        {
+            if (s->output[0].width != p->winWidth || s->output[0].height != p->winHeight)
+            {   // buffers are only reallocated when the window size changes
+                for (int j = 0; j < 2; j++)
+                {
+                    fb_delete(&s->output[j]);
+                    fb_init(&s->output[j], p->winWidth, p->winHeight, 1);
+                }
+            }
+            glBindFramebuffer(GL_FRAMEBUFFER, s->output[s->output_idx ^ 1].framebuffer); GLCHK;
+        } else
+            glBindFramebuffer(GL_FRAMEBUFFER, p->framebuffer); GLCHK;
+        if (p->pass_queries)
+            glBeginQuery(GL_TIME_ELAPSED, p->pass_queries[i]); GLCHK;
+        shadertoy_renderpass(s, p);
+        if (p->pass_queries)
+            glEndQuery(GL_TIME_ELAPSED); GLCHK;
+        if (PASS_BUFFER == s->type)
+            s->output_idx ^= 1;
+    }
+}
+
+static int switch_val(jfes_value_t *str, const char **vals)
+{   // -1 for a missing or unknown value, the api grows new ones
+    if (!str || jfes_type_string != str->type)
+        return -1;
+    for (int i = 0; *vals; i++, vals++)
+        if (!strcmp(*vals, str->data.string_val.data))
+            return i;
+    return -1;
+}
+
+static int sampler_val(jfes_value_t *str, const char **vals, int def)
+{
+    int val = switch_val(str, vals);
+    return val < 0 ? def : val;
+}
+
+static int json_count(jfes_value_t *v)
+{   // array items, 0 for anything else
+    return v && jfes_type_array == v->type ? v->data.array_val->count : 0;
+}
+
+static char *json_id(jfes_value_t *v)
+{
+    char buf[32];
+    if (!v)
+        return 0;
+    if (jfes_type_string == v->type)
+        return strdup(v->data.string_val.data);
+    snprintf(buf, sizeof(buf), "%d", v->data.int_val);
+    return strdup(buf);
+}
+
+#define MAX_DECODERS 8
+#define UPLOAD_RING 4
+
+// a fetch thread reads the cache and downloads, a thread pool decodes, and the thread owning
+// the context uploads through a ring of pixel unpack buffers in shadertoy_pump()
+typedef struct ASSET_LOADER
+{
+    ASSET assets[MAX_ASSETS];
+    int count;
+    pthread_t fetcher, threads[MAX_DECODERS];
+    int has_fetcher, num_threads;
+    volatile int quit;
+    pthread_mutex_t lock;
+    pthread_cond_t work, decoded;
+    ASSET *queue[MAX_ASSETS], *finished[MAX_ASSETS];
+    int head, tail, num_finished;
+    ASSET *downloads[MAX_ASSETS]; // fetch thread only
+    // context thread only
+    ASSET *uploads[MAX_ASSETS];
+    int num_uploads, num_decoded;
+    GLuint pbo[UPLOAD_RING];
+    GLsizeiptr pbo_size[UPLOAD_RING];
+    GLsync fences[UPLOAD_RING];
+    int ring_pos;
+} ASSET_LOADER;
+
+static void decoder_finished(ASSET_LOADER *l, ASSET *a)
+{
+    pthread_mutex_lock(&l->lock);
+    l->finished[l->num_finished++] = a;
+    pthread_cond_signal(&l->decoded);
+    pthread_mutex_unlock(&l->lock);
+}
+
+static void *decoder_thread(void *arg)
+{
+    ASSET_LOADER *l = (ASSET_LOADER *)arg;
+    pthread_mutex_lock(&l->lock);
+    for (;;)
+    {
+        while (l->head == l->tail && !l->quit)
+            pthread_cond_wait(&l->work, &l->lock);
+        if (l->head == l->tail)
+            break;
+        ASSET *a = l->queue[l->head++];
+        pthread_mutex_unlock(&l->lock);
+        image_decode(a);
+        decoder_finished(l, a);
+        pthread_mutex_lock(&l->lock);
+    }
+    pthread_mutex_unlock(&l->lock);
+    return 0;
+}
+
+static void decoder_submit(ASSET_LOADER *l, ASSET *a)
+{
+    if (!l->num_threads)
+    {
+        image_decode(a);
+        decoder_finished(l, a);
+        return;
+    }
+    pthread_mutex_lock(&l->lock);
+    l->queue[l->tail++] = a;
+    pthread_cond_signal(&l->work);
+    pthread_mutex_unlock(&l->lock);
+}
+
+#ifdef HAVE_CURL
+static void asset_downloaded(void *user, int index, char *data, int size)
+{
+    ASSET_LOADER *l = (ASSET_LOADER *)user;
+    ASSET *a = l->downloads[index];
+    if (data)
+    {
+        printf("load %s (%d bytes)\n", a->url, size);
+        store_put(a->url + 26, 0, 0, data, size);
+    }
+    a->data = data, a->size = size;
+    decoder_submit(l, a);
+}
+#endif
+
+static char *asset_read(ASSET *a)
+{   // media files next to the binary work without curl
+    char *data = (char *)store_get(a->url + 26, &a->size);
+    return data ? data : (char *)load_file(a->url + 26, &a->size);
+}
+
+static void *fetch_thread(void *arg)
+{   // local cache first, everything missing is downloaded concurrently
+    ASSET_LOADER *l = (ASSET_LOADER *)arg;
+    const char *urls[MAX_ASSETS];
+    ASSET *dups[MAX_ASSETS];
+    int num_downloads = 0, num_dups = 0;
+    for (int i = 0; i < l->count && !l->quit; i++)
+    {
+        ASSET *a = &l->assets[i];
+#ifdef HAVE_CURL
+        int dup = 0;
+        for (int j = 0; j < num_downloads && !dup; j++)
+            dup = !strcmp(urls[j], a->url);
+        if (dup)
+        {   // same file on another channel, read from the cache once downloaded
+            dups[num_dups++] = a;
+            continue;
+        }
+#endif
+        a->data = asset_read(a);
+#ifdef HAVE_CURL
+        if (!a->data && !_store.offline)
+        {
+            urls[num_downloads] = a->url;
+            l->downloads[num_downloads++] = a;
+            continue;
+        }
+#endif
+        decoder_submit(l, a);
+    }
+#ifdef HAVE_CURL
+    download_all(urls, num_downloads, asset_downloaded, l, &l->quit);
+#endif
+    for (int i = 0; i < num_dups && !l->quit; i++)
+    {
+        dups[i]->data = asset_read(dups[i]);
+        decoder_submit(l, dups[i]);
+    }
+    return 0;
+}
+
+static void load_assets(SHADERTOY *t, ASSET *assets, int count)
+{
+    int cpus = 4;
+#ifdef _SC_NPROCESSORS_ONLN
+    cpus = sysconf(_SC_NPROCESSORS_ONLN);
+#endif
+    if (!count)
+        return;
+    ASSET_LOADER *l = (ASSET_LOADER *)calloc(1, sizeof(ASSET_LOADER));
+    memcpy(l->assets, assets, count*sizeof(ASSET));
+    l->count = count;
+    pthread_mutex_init(&l->lock, NULL);
+    pthread_cond_init(&l->work, NULL);
+    pthread_cond_init(&l->decoded, NULL);
+    for (int i = 0; i < count && i < cpus && i < MAX_DECODERS; i++)
+        if (!pthread_create(&l->threads[l->num_threads], NULL, decoder_thread, l))
+            l->num_threads++;
+    l->has_fetcher = !pthread_create(&l->fetcher, NULL, fetch_thread, l);
+    if (!l->has_fetcher)
+        fetch_thread(l);
+    t->loader = l;
+}
+
+static void loader_close(ASSET_LOADER *l)
+{   // context thread, also cancels a load in progress
+    pthread_mutex_lock(&l->lock);
+    l->quit = 1;
+    pthread_cond_broadcast(&l->work);
+    pthread_mutex_unlock(&l->lock);
+    if (l->has_fetcher)
+        pthread_join(l->fetcher, NULL);
+    for (int i = 0; i < l->num_threads; i++)
+        pthread_join(l->threads[i], NULL);
+    pthread_cond_destroy(&l->work);
+    pthread_cond_destroy(&l->decoded);
+    pthread_mutex_destroy(&l->lock);
+    for (int i = 0; i < UPLOAD_RING; i++)
+    {
+        if (l->fences[i])
+            glDeleteSync(l->fences[i]); GLCHK;
+        if (l->pbo[i])
+            glDeleteBuffers(1, &l->pbo[i]); GLCHK;
+    }
+    for (int i = 0; i < l->count; i++)
+    {
+        ASSET *a = &l->assets[i];
+        if (a->data)
+            free(a->data);
+        image_free(a);
+        free(a->url);
+    }
+    free(l);
+}
+
+static int loader_upload(ASSET_LOADER *l, ASSET *a, int wait)
+{   // one texture, all six faces for a cubemap, returns 0 while the next ring slot is in use
+    SHADER_INPUT *inp = a->inp;
+    int faces = inp->is_cubemap ? 6 : 1, w = a->w, h = a->h, slot = l->ring_pos;
+    GLsizeiptr face_size = (GLsizeiptr)w*h*4;
+    const unsigned char *src[6] = { 0 };
+    unsigned char *dst = 0;
+    if (!a->pix)
+        faces = 0; // nothing to show without the first face
+    for (int i = 0; i < faces; i++)
+    {
+        if (a[i].pix && a[i].w == w && a[i].h == h)
+            src[i] = a[i].pix;
+        else if (inp->is_cubemap)
+            printf("error: cubemap face %s missing or not %dx%d\n", a[i].url, w, h);
+    }
+    if (faces && glMapBufferRange && glFenceSync)
+    {
+        if (l->fences[slot])
+        {
+            GLenum res;
+            do
+                res = glClientWaitSync(l->fences[slot], GL_SYNC_FLUSH_COMMANDS_BIT, wait ? 100000000 : 0);
+            while (wait && GL_TIMEOUT_EXPIRED == res);
+            if (GL_TIMEOUT_EXPIRED == res)
+                return 0;
+            glDeleteSync(l->fences[slot]); GLCHK;
+            l->fences[slot] = 0;
+        }
+        if (!l->pbo[slot])
+            glGenBuffers(1, &l->pbo[slot]); GLCHK;
+        glBindBuffer(GL_PIXEL_UNPACK_BUFFER, l->pbo[slot]); GLCHK;
+        if (l->pbo_size[slot] < face_size*faces)
+        {
+            glBufferData(GL_PIXEL_UNPACK_BUFFER, face_size*faces, 0, GL_STREAM_DRAW); GLCHK;
+            l->pbo_size[slot] = face_size*faces;
+        }
+        // the fence above guarantees the previous upload from this slot is done
+        dst = (unsigned char *)glMapBufferRange(GL_PIXEL_UNPACK_BUFFER, 0, face_size*faces,
+            GL_MAP_WRITE_BIT | GL_MAP_INVALIDATE_BUFFER_BIT | GL_MAP_UNSYNCHRONIZED_BIT); GLCHK;
+        if (dst)
+        {
+            for (int i = 0; i < faces; i++)
+                if (src[i])
+                    memcpy(dst + i*face_size, src[i], face_size);
+            if (!glUnmapBuffer(GL_PIXEL_UNPACK_BUFFER))
+                dst = 0; // contents lost, upload from client memory
+            GLCHK;
+        }
+        if (!dst)
+            glBindBuffer(GL_PIXEL_UNPACK_BUFFER, 0); GLCHK;
+    }
+    if (faces)
+    {
+        texture_create(inp, w, h);
+        for (int i = 0; i < faces; i++)
+            if (src[i])
+                texture_face(inp, i, dst ? (const unsigned char *)0 + i*face_size : src[i]);
+        texture_finish(inp);
+    }
+    if (dst)
+    {
+        glBindBuffer(GL_PIXEL_UNPACK_BUFFER, 0); GLCHK;
+        l->fences[slot] = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0); GLCHK;
+        l->ring_pos = (slot + 1) % UPLOAD_RING;
+    }
+    for (int i = 0; i < (inp->is_cubemap ? 6 : 1); i++)
+        image_free(&a[i]);
+    return 1;
+}
+
+int shadertoy_pump(SHADERTOY *t, int wait)
+{   // uploads decoded textures, returns 1 while some are still loading. Without wait only
+    // what is ready and fits in the upload ring goes, so rendering starts before textures are in
+    ASSET_LOADER *l = t->loader;
+    if (!l)
+        return 0;
+    for (;;)
+    {
+        ASSET *finished[MAX_ASSETS];
+        pthread_mutex_lock(&l->lock);
+        while (wait && !l->num_finished && !l->num_uploads && l->num_decoded < l->count)
+            pthread_cond_wait(&l->decoded, &l->lock);
+        int count = l->num_finished;
+        memcpy(finished, l->finished, count*sizeof(ASSET *));
+        l->num_finished = 0;
+        pthread_mutex_unlock(&l->lock);
+        l->num_decoded += count;
+        for (int i = 0; i < count; i++)
+        {
+            ASSET *a = finished[i], *first = a - a->face;
+            int complete = 1;
+            a->done = 1;
+            for (int k = 0; k < (a->inp->is_cubemap ? 6 : 1); k++)
+                complete &= first[k].done;
+            if (complete)
+                l->uploads[l->num_uploads++] = first;
+        }
+        int uploaded = 0;
+        while (uploaded < l->num_uploads && loader_upload(l, l->uploads[uploaded], wait))
+            uploaded++;
+        l->num_uploads -= uploaded;
+        memmove(l->uploads, l->uploads + uploaded, l->num_uploads*sizeof(ASSET *));
+        if (l->num_decoded == l->count && !l->num_uploads)
+        {
+            loader_close(l);
+            t->loader = 0;
+            return 0;
+        }
+        if (!wait)
+            return 1;
+    }
+}
+static void sort_passes(SHADERTOY *t)
+{
+    int placed[MAX_PASSES] = { 0 }, count = 0, passes = 0;
+    for (int i = 0; i < MAX_PASSES; i++)
+        if (PASS_IMAGE == t->shaders[i].type || PASS_BUFFER == t->shaders[i].type)
+            passes++;
+        else
+            placed[i] = 1;
+    while (count < passes)
+    {
+        int next = -1, fallback = -1;
+        for (int i = 0; i < MAX_PASSES && next < 0; i++)
+        {
+            SHADER *s = &t->shaders[i];
+            if (placed[i] || PASS_BUFFER != s->type)
+                continue;
+            if (fallback < 0)
+                fallback = i;
+            int ready = 1;
+            for (int j = 0; j < 4; j++)
+            {
+                SHADER *dep = s->inputs[j].buffer;
+                if (dep && dep != s && !placed[dep - t->shaders])
+                    ready = 0;
+            }
+            if (ready)
+                next = i;
+        }
+        if (next < 0)
+            next = fallback; // feedback cycle, earlier buffers read the previous frame of later ones
+        if (next < 0)
+            for (int i = 0; i < MAX_PASSES; i++)
+                if (!placed[i])
+                    next = i; // image pass
+        placed[next] = 1;
+        t->order[count++] = next;
+    }
+    t->num_passes = count;
+}
+
+int load_json(SHADERTOY *t, char *buffer, int buf_size, ASSET *assets, int *num_assets)
+{   // 1 when buffer is not a shader json, -1 for one that can not be played
+    jfes_config_t config = { 0 };
+    config.jfes_malloc = (jfes_malloc_t)malloc;
+    config.jfes_free = free;
+    jfes_arena_t arena; // the whole tree is freed at once
+    jfes_init_arena(&arena, 0);
+    config.arena = &arena;
+
+    jfes_value_t value;
+    jfes_status_t status = jfes_parse_in_place(&config, buffer, buf_size, &value); // strings point into buffer
+    if (!jfes_status_is_good(status))
+    {
+       jfes_release_arena(&config);
+       return 1;
+    }
+    jfes_value_t *root = json_count(&value) ? value.data.array_val->items[0] : 0;
+    jfes_value_t *rp = jfes_get_child(root, "renderpass", 0);
+    if (!json_count(rp))
+    {   // "[]" or an api error
+        printf("error: no render passes.\n");
+        jfes_release_arena(&config);
+        return -1;
+    }
+    if (rp->data.array_val->count > MAX_PASSES)
+    {
+        printf("error: too many render passes.\n");
+        jfes_release_arena(&config);
+        return -1;
+    }
+
+    SHADER *shaders = t->shaders;
+    *num_assets = 0;
+    for (int i = 0; i < MAX_PASSES; i++)
+        shaders[i].type = PASS_NONE;
+    for (int i = 0; i < rp->data.array_val->count; i++)
+    {
+        SHADER *s = &shaders[i];
+        jfes_value_t *pass = rp->data.array_val->items[i];
+        jfes_value_t *type = jfes_get_child(pass, "type", 0);
+        static const char *rp_types[] = { "image", "common", "buffer", "cubemap", "sound", 0 };
+        jfes_value_t *code = jfes_get_child(pass, "code", 0);
+        s->type = switch_val(type, rp_types);
+        if (!code || jfes_type_string != code->type)
+            s->type = PASS_NONE;
+        if (PASS_COMMON == s->type)
+        {
+            if (t->common_code)
+            {
+                printf("error: common code already exists.");
+                exit(1);
+            }
+            t->common_code = code->data.string_val.data; // unescaped in place, it only gets shorter
+            unescape_json(t->common_code, code->data.string_val.size, t->common_code);
+        }
+    }
+    for (int i = 0; i < rp->data.array_val->count; i++)
+    {
+        SHADER *s = &shaders[i];
+        jfes_value_t *pass = rp->data.array_val->items[i];
+        jfes_value_t *inputs  = jfes_get_child(pass, "inputs", 0);
+        jfes_value_t *outputs = jfes_get_child(pass, "outputs", 0);
+        if (PASS_IMAGE != s->type && PASS_BUFFER != s->type)
+            continue;
+        int j, used = 0;
+        for (j = 0; j < json_count(inputs); j++)
+        {
+           static const char *types[] = { "texture", "buffer", "cubemap", "musicstream", "music", "keyboard", 0 };
+           jfes_value_t *input = inputs->data.array_val->items[j];
+           jfes_value_t *iid   = jfes_get_child(input, "id", 0);
+           jfes_value_t *itype_val = jfes_get_child(input, "type", 0);
+           int itype = switch_val(itype_val, types);
+           jfes_value_t *ichannel = jfes_get_child(input, "channel", 0);
+           jfes_value_t *filepath = jfes_get_child(input, "filepath", 0);
+           jfes_value_t *sampler  = jfes_get_child(input, "sampler", 0);
+           if (!ichannel || jfes_type_integer != ichannel->type || ichannel->data.int_val < 0 || ichannel->data.int_val > 3)
+               continue;
+           if (itype < 0)
+           {   // volume, video, webcam, mic: the channel stays black
+               printf("warning: unsupported input type %s\n", itype_val && jfes_type_string == itype_val->type ? itype_val->data.string_val.data : "?");
+               continue;
+           }
+           if (used & (1 << ichannel->data.int_val))
+           {   // the first input keeps the channel, a second one would leak its id and texture
+               printf("warning: channel %d already has an input\n", ichannel->data.int_val);
+               continue;
+           }
+           int components = (2 == itype) ? 6 : 1;
+           if (filepath && jfes_type_string == filepath->type && (0 == itype || 2 == itype) && *num_assets + components > MAX_ASSETS)
+           {   // a cubemap is uploaded as a group of six faces, never a part of one
+               printf("warning: too many assets, channel %d skipped\n", ichannel->data.int_val);
+               continue;
+           }
+           used |= 1 << ichannel->data.int_val;
+           SHADER_INPUT *inp = s->inputs + ichannel->data.int_val;
+           SAMPLER *smp = &inp->sampler;
+           inp->id = json_id(iid);
+           inp->is_cubemap = (2 == itype);
+           if (sampler)
+           {
+              static const char *filter[] = { "nearest", "linear", "mipmap", 0 };
+              static const char *wrap[]   = { "clamp", "repeat", 0 };
+              static const char *bools[]  = { "false", "true", 0 };
+              static const char *internal[] = { "byte", 0 };
+              smp->filter = sampler_val(jfes_get_child(sampler, "filter", 0), filter, 2);
+              smp->wrap   = sampler_val(jfes_get_child(sampler, "wrap", 0), wrap, 1);
+              smp->vflip  = sampler_val(jfes_get_child(sampler, "vflip", 0), bools, 1);
+              smp->srgb   = sampler_val(jfes_get_child(sampler, "srgb", 0), bools, 0);
+              smp->internal = sampler_val(jfes_get_child(sampler, "internal", 0), internal, 0);
+           }
+           if (1 == itype)
+               inp->buffer = s; // resolved to the producing pass once all outputs are known
+           if (filepath && jfes_type_string == filepath->type && (0 == itype || inp->is_cubemap))
+           {
+                for (int k = 0; k < components; k++)
+                {
+                    ASSET *a = &assets[(*num_assets)++];
+                    char *buf = malloc(filepath->data.string_val.size + 26 + 2);
+                    strcpy(buf, "https://www.shadertoy.com");
+                    unescape_json(filepath->data.string_val.data, filepath->data.string_val.size, buf + 25);
+                    if (k)
+                    {
+                        char *s = strrchr(buf, '.');
+                        if (s)
+                        {
+                            int len = strlen(s);
+                            s[len + 2] = 0;
+                            for (; len; len--)
+                                s[len + 1] = s[len - 1];
+                            s[0] = '_';
+                            s[1] = '0' + k;
+                        }
+                    }
+                    memset(a, 0, sizeof(*a));
+                    a->inp = inp, a->face = k, a->url = buf;
+                }
+           }
+           //printf("i type=%d, id=%s, channel=%d\n", itype, inp->id, ichannel->data.int_val);
+        }
+        for (j = 0; j < json_count(outputs); j++)
+        {
+           jfes_value_t *output = outputs->data.array_val->items[j];
+           jfes_value_t *oid    = jfes_get_child(output, "id", 0);
+           //jfes_value_t *ochannel = jfes_get_child(output, "channel", 0);
+           s->output[0].id = json_id(oid);
+           //printf("o id=%s, channel=%d\n", s->output[0].id, ochannel->data.int_val);
+        }
+    }
+    for (int i = 0; i < rp->data.array_val->count; i++)
+    {
+        SHADER *s = &shaders[i];
+        for (int j = 0; j < 4; j++)
+        {
+            SHADER_INPUT *inp = &s->inputs[j];
+            if (!inp->buffer)
+                continue;
+            inp->buffer = 0; // an input without an id reads nothing
+            if (!inp->id)
+                continue;
+            for (int k = 0; k < rp->data.array_val->count; k++)
+                if (PASS_BUFFER == shaders[k].type && shaders[k].output[0].id && !strcmp(shaders[k].output[0].id, inp->id))
+                    inp->buffer = &shaders[k];
+        }
+    }
+    sort_passes(t);
+    for (int i = 0; i < rp->data.array_val->count; i++)
+    {
+        SHADER *s = &shaders[i];
+        jfes_value_t *pass = rp->data.array_val->items[i];
+        jfes_value_t *code = jfes_get_child(pass, "code", 0);
+        if (PASS_IMAGE != s->type && PASS_BUFFER != s->type)
+            continue;
+        //printf("type=%s\n", type->data.string_val.data);
+        t->code[i] = code->data.string_val.data;
+        unescape_json(t->code[i], code->data.string_val.size, t->code[i]);
+    }
+    jfes_release_arena(&config);
+    return 0;
+}
+
+#define API_CACHE_TTL (24*60*60) // seconds an api response is used without revalidating it
+
+typedef struct API_CACHE_HEADER
+{
+    char magic[4]; // "TOYA"
+    uint32_t reserved;
+    int64_t fetched, modified;
+    char etag[128];
+} API_CACHE_HEADER;
+
+static int json_empty_array(const char *data, int size)
+{   // "[]", an unknown shader id, is not worth caching
+    int i = 1;
+    while (i < size && (' ' == data[i] || '\t' == data[i] || '\r' == data[i] || '\n' == data[i]))
+        i++;
+    return '[' == data[0] && i < size && ']' == data[i];
+}
+
+static char *load_shader_url(const char *url, int *size, int revalidate)
+{   // api responses are cached by shader id, stale ones are revalidated and used when the network is down
+    API_CACHE_HEADER hdr;
+    char name[128], *data = 0;
+    const char *id = strrchr(url, '/');
+    int cached_size = 0;
+    int64_t now = time(NULL);
+    *size = 0;
+    if (!id || !id[1] || strlen(id) > 64)
+    {
+        printf("error: no shader id in %s\n", url);
+        return 0;
+    }
+    snprintf(name, sizeof(name), "shader/%s", id + 1);
+    char *cached = (char *)store_get(name, &cached_size);
+    if (cached && ((size_t)cached_size <= sizeof(hdr) || memcmp(cached, "TOYA", 4)))
+    {
+        free(cached);
+        cached = 0;
+    }
+    if (cached)
+    {   // body moves to the front, store_get leaves room for the terminator
+        memcpy(&hdr, cached, sizeof(hdr));
+        cached_size -= sizeof(hdr);
+        memmove(cached, cached + sizeof(hdr), cached_size);
+        cached[cached_size] = 0;
+        if (_store.offline || (!revalidate && now - hdr.fetched < API_CACHE_TTL))
+        {
+            *size = cached_size;
+            return cached;
+        }
+    }
+#ifdef HAVE_CURL
+    if (!_store.offline)
+    {
+        HTTP_VALIDATORS v;
+        memset(&v, 0, sizeof(v));
+        if (cached)
+        {
+            memcpy(v.etag, hdr.etag, sizeof(v.etag));
+            v.etag[sizeof(v.etag) - 1] = 0;
+            v.modified = hdr.modified;
+        }
+        data = load_url(url, size, 1, &v);
+        if (data && *size > 0 && '[' == data[0] && !json_empty_array(data, *size) && 200 == v.status)
+        {
+            memset(&hdr, 0, sizeof(hdr));
+            memcpy(hdr.magic, "TOYA", 4);
+            memcpy(hdr.etag, v.etag, sizeof(hdr.etag));
+            hdr.fetched = now, hdr.modified = v.modified;
+            store_put(name, &hdr, sizeof(hdr), data, *size);
+            if (cached)
+                free(cached);
+            return data;
+        }
+        if (cached && 304 == v.status)
+        {   // unchanged, good for another ttl
+            hdr.fetched = now;
+            store_put(name, &hdr, sizeof(hdr), cached, cached_size);
+        } else if (cached)
+            printf("warning: refreshing %s failed, using the cached copy\n", url);
+    }
+#endif
+    if (!cached)
+    {
+        if (_store.offline)
+            printf("error: %s is not cached\n", url);
+        return data;
+    }
+    if (data)
+        free(data);
+    *size = cached_size;
+    return cached;
+}
+
+static char *load_source(const char *src, int *size, int revalidate)
+{
+    if (strstr(src, "://"))
+        return load_shader_url(src, size, revalidate);
+    return (char *)load_file(src, size);
+}
+
+int shadertoy_parse(SHADERTOY *t, char *buffer, int buf_size, int is_url)
+{   // no gl calls, can run before the context exists. Textures start loading from here. Takes the buffer
+    ASSET assets[MAX_ASSETS];
+    int num_assets = 0, res = 1;
+    memset(t, 0, sizeof(*t));
+    t->source = buffer;
+    if ('[' == buffer[0])
+        res = load_json(t, buffer, buf_size, assets, &num_assets);
+    if (res < 0)
+        return 0;
+    if (res)
+    {   // not a json
+        if (is_url)
+            return 0;
+        t->code[0] = buffer;
+        t->num_passes = 1;
+    } else
+        load_assets(t, assets, num_assets);
+    return 1;
+}
+
+void shadertoy_compile(SHADERTOY *t)
+{
+    SHADER *compiling[MAX_PASSES];
+    int num_compiling = 0;
+    for (int i = 0; i < MAX_PASSES; i++)
+        if (t->code[i])
+        {
+            shader_compile(&t->shaders[i], t->code[i], t->common_code);
+            compiling[num_compiling++] = &t->shaders[i];
+            t->code[i] = 0;
+        }
+    t->errors = shaders_finish(compiling, num_compiling); // may recompile with the common code as text
+    t->common_code = 0;
+    free(t->source);
+    t->source = 0;
+}
+
+static int shadertoy_supported(SHADERTOY *t)
+{
+    for (int i = 0; i < t->num_passes; i++)
+        if (PASS_BUFFER == t->shaders[t->order[i]].type && !fb_supported())
+        {
+            printf("error: buffer passes need framebuffer objects, this context has none\n");
+            return 0;
+        }
+    return 1;
+}
+
+int shadertoy_load(SHADERTOY *t, char *buffer, int buf_size, int is_url)
+{
+    if (!shadertoy_parse(t, buffer, buf_size, is_url))
+        return 0;
+    shadertoy_compile(t);
+    return 1;
+}
+
+void shadertoy_delete(SHADERTOY *t)
+{
+    if (t->loader)
+        loader_close(t->loader);
+    t->loader = 0;
+    t->common_code = 0;
+    if (t->source)
+        free(t->source);
+    t->source = 0;
+    for (int i = 0; i < MAX_PASSES; i++)
+    {
+        t->code[i] = 0;
+        for (int j = 0; j < 4; j++)
+        {
+            if (t->shaders[i].inputs[j].tex)
+                glDeleteTextures(1, &t->shaders[i].inputs[j].tex); GLCHK;
+            if (t->shaders[i].inputs[j].sampler_object)
+                glDeleteSamplers(1, &t->shaders[i].inputs[j].sampler_object); GLCHK;
+        }
+        shader_delete(&t->shaders[i]);
+    }
+}
+
+static void shadertoy_replace(SHADERTOY *t, SHADERTOY *n)
+{
+    for (int i = 0; i < MAX_PASSES; i++)
+    {   // buffers with the same id keep their contents across edits
+        SHADER *s = &n->shaders[i];
+        for (int j = 0; j < MAX_PASSES && PASS_BUFFER == s->type && s->output[0].id; j++)
+        {
+            SHADER *o = &t->shaders[j];
+            if (PASS_BUFFER != o->type || !o->output[0].id || strcmp(o->output[0].id, s->output[0].id))
+                continue;
+            for (int k = 0; k < 2; k++)
+            {
+                FBO *f = &s->output[k], *of = &o->output[k];
+                f->framebuffer = of->framebuffer, f->framebufferTex = of->framebufferTex;
+                f->floatTex = of->floatTex, f->width = of->width, f->height = of->height;
+                of->framebuffer = of->framebufferTex = 0;
+            }
+            s->output_idx = o->output_idx;
+        }
+    }
+    shadertoy_delete(t);
+    *t = *n;
+    for (int i = 0; i < MAX_PASSES; i++)
+        for (int j = 0; j < 4; j++)
+            if (t->shaders[i].inputs[j].buffer)
+                t->shaders[i].inputs[j].buffer = t->shaders + (t->shaders[i].inputs[j].buffer - n->shaders);
+}
+
+// startup fetches and parses the shader while the window and context are created, downloads
+// and decodes run from there on and compiling starts once both are done
+static struct
+{
+    pthread_t thread;
+    const char *src;
+    int is_url, parsed;
+    SHADERTOY *toy;
+} _startup;
+
+static void *startup_thread(void *arg)
+{
+    int buf_size;
+    char *buffer = load_source(_startup.src, &buf_size, 0);
+    if (!buffer)
+        return 0;
+    _startup.parsed = shadertoy_parse(_startup.toy, buffer, buf_size, _startup.is_url);
+    return 0;
+}
+
+// reload on a worker thread with a shared context, the running shader keeps drawing until the new one is ready
+static struct
+{
+    pthread_t thread;
+    pthread_mutex_t lock;
+    int running, done;
+    const char *src;
+    time_t mtime;
+    double check_time;
+    SHADERTOY *toy; // 0 when the reload failed
+    GLsync fence;
+} _reload = { .lock = PTHREAD_MUTEX_INITIALIZER };
+
+static void *reload_thread(void *arg)
+{
+    int buf_size;
+    GLsync fence = 0;
+    SHADERTOY *t = (SHADERTOY *)malloc(sizeof(SHADERTOY));
+    common_claim(); // the main thread is done compiling
+    gl_worker_bind(1);
+#ifdef _DEBUG
+    gl_debug_init(); // per context
+#endif
+    char *buffer = load_source(_reload.src, &buf_size, 1);
+    if (buffer && shadertoy_load(t, buffer, buf_size, 0 != strstr(_reload.src, "://")) && !t->errors && shadertoy_supported(t))
+    {
+        shadertoy_pump(t, 1);
+        if (glFenceSync)
+        {
+            fence = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0); GLCHK;
+            glFlush(); GLCHK;
+        } else
+            glFinish(); GLCHK;
+    } else
+    {
+        if (buffer)
+            shadertoy_delete(t);
+        free(t);
+        t = 0;
+        printf("reload of %s failed, keeping the current shader\n", _reload.src);
+    }
+    gl_worker_bind(0);
+    pthread_mutex_lock(&_reload.lock);
+    _reload.toy = t, _reload.fence = fence, _reload.done = 1;
+    pthread_mutex_unlock(&_reload.lock);
+    return 0;
+}
+
+static void reload_start()
+{
+    if (_reload.running || !gl_worker_init())
+        return;
+    _reload.done = 0, _reload.toy = 0, _reload.fence = 0;
+    _reload.running = !pthread_create(&_reload.thread, NULL, reload_thread, NULL);
+}
+
+static int reload_changed(double now)
+{   // local files are polled twice a second
+    struct stat st;
+    if (strstr(_reload.src, "://") || now - _reload.check_time < 0.5)
+        return 0;
+    _reload.check_time = now;
+    if (stat(_reload.src, &st) || st.st_mtime == _reload.mtime)
+        return 0;
+    _reload.mtime = st.st_mtime;
+    return 1;
+}
+
+static int reload_poll(SHADERTOY *t)
+{   // called between frames, returns 1 when t was replaced
+    pthread_mutex_lock(&_reload.lock);
+    int done = _reload.running && _reload.done;
+    pthread_mutex_unlock(&_reload.lock);
+    if (!done)
+        return 0;
+    if (_reload.fence)
+    {
+        if (GL_TIMEOUT_EXPIRED == glClientWaitSync(_reload.fence, 0, 0))
+            return 0; // worker commands still in flight
+        glDeleteSync(_reload.fence); GLCHK;
+        _reload.fence = 0;
+    }
+    pthread_join(_reload.thread, NULL);
+    _reload.running = 0;
+    if (!_reload.toy)
+        return 0;
+    shadertoy_replace(t, _reload.toy);
+    free(_reload.toy);
+    printf("reloaded %s\n", _reload.src);
+    _reload.toy = 0;
+    return 1;
+}
+
+static void reload_close()
+{
+    if (_reload.running)
+    {
+        pthread_join(_reload.thread, NULL);
+        if (_reload.fence)
+            glDeleteSync(_reload.fence); GLCHK;
+        if (_reload.toy)
+        {
+            shadertoy_delete(_reload.toy);
+            free(_reload.toy);
+        }
+        _reload.running = 0;
+    }
+    gl_worker_close();
+}
+
+void profiler_reset(PROFILER *pr, int num_passes)
+{   // after a reload, in flight samples were taken with the old passes
+    for (int i = 0; i < pr->num_frames; i++)
+        pr->frames[i].frame = -1;
+    pr->frame = -1;
+    pr->num_passes = num_passes;
+}
+
+void profiler_init(PROFILER *pr, int num_passes, FILE *csv, int overlay, int bench_frames)
+{
+    memset(pr, 0, sizeof(*pr));
+    pr->csv = csv;
+    pr->overlay = overlay;
+    if (csv)
+    {   // one header for every pass count, a reload can add or remove passes
+        fprintf(csv, "frame,cpu_ms,swap_ms,gpu_ms");
+        for (int i = 0; i < MAX_PASSES; i++)
+            fprintf(csv, ",pass%d_ms", i);
+        fprintf(csv, "\n");
+    }
+    // timer queries only when something reads them
+    pr->has_timer = (csv || overlay || bench_frames > 0) &&
+        (GLAD_GL_ARB_timer_query || GLVersion.major > 3 || (3 == GLVersion.major && GLVersion.minor >= 3));
+    pr->num_frames = PROFILER_FRAMES;
+    if (bench_frames > 0)
+    {   // a benchmark keeps every gpu time, dropping the late ones would bias the statistics, and
+        // waiting for them every frame would keep the gpu from running ahead, so each frame gets its
+        // own query set and they are read once the run is over
+        pr->num_frames = bench_frames;
+        pr->cpu_log = (double *)malloc(bench_frames*sizeof(double));
+        pr->gpu_log = pr->has_timer ? (double *)malloc(bench_frames*sizeof(double)) : 0;
+        pr->log_size = bench_frames;
+    }
+    pr->frames = (PROFILER_FRAME *)calloc(pr->num_frames, sizeof(PROFILER_FRAME));
+    if (pr->has_timer)
+        for (int i = 0; i < pr->num_frames; i++)
+            glGenQueries(MAX_PASSES, pr->frames[i].queries); GLCHK;
+    profiler_reset(pr, num_passes);
+}
+
+void profiler_delete(PROFILER *pr)
+{
+    if (pr->has_timer)
+        for (int i = 0; i < pr->num_frames; i++)
+            glDeleteQueries(MAX_PASSES, pr->frames[i].queries); GLCHK;
+    free(pr->frames);
+    if (pr->cpu_log)
+        free(pr->cpu_log);
+    if (pr->gpu_log)
+        free(pr->gpu_log);
+}
+
+static int profiler_resolve(PROFILER *pr, PROFILER_FRAME *f)
+{
+    if (f->frame < 0)
+        return 0;
+    float pass_ms[MAX_PASSES] = { 0 }, gpu_ms = 0;
+    if (pr->has_timer && pr->num_passes > 0)
+    {   // a shader of only common code draws nothing and begins no query
+        GLuint available = 1;
+        if (!pr->wait)
+            glGetQueryObjectuiv(f->queries[pr->num_passes - 1], GL_QUERY_RESULT_AVAILABLE, &available); GLCHK;
+        if (!available)
+        {   // never block the render loop, the sample is dropped instead
+            f->frame = -1;
+            return 0;
+        }
+        for (int i = 0; i < pr->num_passes; i++)
+        {
+            GLuint64 ns = 0;
+            glGetQueryObjectui64v(f->queries[i], GL_QUERY_RESULT, &ns); GLCHK;
+            pass_ms[i] = ns*1e-6f;
+            gpu_ms += pass_ms[i];
+        }
+    }
+    memcpy(pr->pass_ms, pass_ms, sizeof(pass_ms));
+    pr->frame = f->frame, pr->gpu_ms = gpu_ms, pr->cpu_ms = f->cpu_ms, pr->swap_ms = f->swap_ms;
+    if (pr->gpu_log && pr->gpu_count < pr->log_size)
+        pr->gpu_log[pr->gpu_count++] = pr->gpu_ms;
+    if (pr->csv)
+    {
+        fprintf(pr->csv, "%d,%.4f,%.4f,%.4f", pr->frame, pr->cpu_ms, pr->swap_ms, pr->gpu_ms);
+        for (int i = 0; i < pr->num_passes; i++)
+            fprintf(pr->csv, ",%.4f", pr->pass_ms[i]);
+        for (int i = pr->num_passes; i < MAX_PASSES; i++)
+            fprintf(pr->csv, ",");
+        fprintf(pr->csv, "\n");
+    }
+    f->frame = -1;
+    return 1;
+}
+
+void profiler_begin(PROFILER *pr, PLATFORM_PARAMS *p)
+{
+    p->pass_queries = pr->has_timer ? pr->frames[p->frame % pr->num_frames].queries : 0;
+}
+
+void profiler_end(PROFILER *pr, PLATFORM_PARAMS *p, float cpu_ms, float swap_ms)
+{
+    PROFILER_FRAME *f = &pr->frames[p->frame % pr->num_frames];
+    f->frame = p->frame, f->cpu_ms = cpu_ms, f->swap_ms = swap_ms;
+    if (pr->cpu_count < pr->log_size) // known now, unlike the gpu time
+        pr->cpu_log[pr->cpu_count++] = cpu_ms + swap_ms;
+    if (!pr->log_size) // a benchmark reads its queries in profiler_flush()
+        profiler_resolve(pr, &pr->frames[(p->frame + 1) % pr->num_frames]);
+}
+
+void profiler_flush(PROFILER *pr, PLATFORM_PARAMS *p)
+{
+    pr->wait = 1;
+    for (int i = 0; i < pr->num_frames; i++) // oldest first
+        profiler_resolve(pr, &pr->frames[(p->frame + i) % pr->num_frames]);
+    if (pr->csv)
+        fflush(pr->csv);
+}
+
+static void overlay_bar(int x, int y, int w, int h, float r, float g, float b)
+{
+    if (w <= 0)
+        return;
+    glScissor(x, y, w, h); GLCHK;
+    glClearColor(r, g, b, 1.0f); GLCHK;
+    glClear(GL_COLOR_BUFFER_BIT); GLCHK;
+}
+
+void profiler_overlay(PROFILER *pr, PLATFORM_PARAMS *p)
+{
+    static const float colors[MAX_PASSES][3] = {
+        { 0.9f, 0.3f, 0.2f }, { 0.2f, 0.8f, 0.3f }, { 0.3f, 0.5f, 1.0f }, { 0.9f, 0.8f, 0.2f }, { 0.8f, 0.3f, 0.9f }
+    };
+    if (pr->frame < 0)
+        return;
+    float px_per_ms = p->winWidth/(2.0f*1000.0f/60.0f); // full width is two 60 Hz frames
+    int x = 0, h = 6;
+    glBindFramebuffer(GL_FRAMEBUFFER, p->framebuffer); GLCHK;
+    glEnable(GL_SCISSOR_TEST); GLCHK;
+    overlay_bar(0, 0, p->winWidth, 3*h + 4, 0.0f, 0.0f, 0.0f);
+    for (int i = 0; i < pr->num_passes; i++)
+    {   // stacked per pass gpu time, in render order
+        int w = (int)(pr->pass_ms[i]*px_per_ms);
+        overlay_bar(x, 2*h + 2, w, h, colors[i][0], colors[i][1], colors[i][2]);
+        x += w;
+    }
+    overlay_bar(0, h + 1, (int)(pr->cpu_ms*px_per_ms), h, 0.8f, 0.8f, 0.8f);
+    overlay_bar(0, 0, (int)(pr->swap_ms*px_per_ms), h, 0.4f, 0.4f, 0.4f);
+    overlay_bar(p->winWidth/2, 0, 1, 3*h + 4, 1.0f, 1.0f, 1.0f);
+    glDisable(GL_SCISSOR_TEST); GLCHK;
+    glClearColor(0.0f, 0.0f, 0.0f, 0.0f); GLCHK;
+    if (_mainWindow && p->cur_time - pr->title_time > 0.5f)
+    {
+        char title[256];
+        int len = snprintf(title, sizeof(title), "Shadertoy - gpu %.2f ms (", pr->gpu_ms);
+        for (int i = 0; i < pr->num_passes && len < (int)sizeof(title); i++)
+            len += snprintf(title + len, sizeof(title) - len, i ? " %.2f" : "%.2f", pr->pass_ms[i]);
+        if (len < (int)sizeof(title))
+            snprintf(title + len, sizeof(title) - len, "), cpu %.2f ms, swap %.2f ms", pr->cpu_ms, pr->swap_ms);
+        glfwSetWindowTitle(_mainWindow, title);
+        pr->title_time = p->cur_time;
+    }
+}
+
+static int cmp_double(const void *a, const void *b)
+{
+    double d = *(const double *)a - *(const double *)b;
+    return (d > 0) - (d < 0);
+}
+
+static void bench_stats(FILE *f, const char *name, double *v, int n, int last)
+{
+    double sum = 0;
+    if (n <= 0)
+    {   // the window was closed before a frame finished
+        fprintf(f, "  \"%s\": null%s\n", name, last ? "" : ",");
+        return;
+    }
+    qsort(v, n, sizeof(double), cmp_double);
+    for (int i = 0; i < n; i++)
+        sum += v[i];
+    #define PERCENTILE(pct) v[(n*pct + 99)/100 - 1]
+    fprintf(f, "  \"%s\": { \"samples\": %d, \"min\": %.4f, \"median\": %.4f, \"p95\": %.4f, \"p99\": %.4f, \"max\": %.4f, \"mean\": %.4f }%s\n",
+        name, n, v[0], PERCENTILE(50), PERCENTILE(95), PERCENTILE(99), v[n - 1], sum/n, last ? "" : ",");
+    #undef PERCENTILE
+}
+
+static void print_json_string(FILE *f, const char *str)
+{
+    fputc('"', f);
+    for (; str && *str; str++)
+    {
+        unsigned char ch = (unsigned char)*str;
+        if ('"' == ch || '\\' == ch)
+            fprintf(f, "\\%c", ch);
+        else if (ch < 0x20)
+            fprintf(f, "\\u%04x", ch);
+        else
+            fputc(ch, f);
+    }
+    fputc('"', f);
+}
+
+static void bench_report(FILE *f, const char *src, int width, int height, int frames, int passes, double total, PROFILER *pr)
+{
+    fprintf(f, "{\n  \"shader\": ");
+    print_json_string(f, src);
+    fprintf(f, ",\n  \"renderer\": ");
+    print_json_string(f, (const char *)glGetString(GL_RENDERER));
+    fprintf(f, ",\n");
+    fprintf(f, "  \"width\": %d, \"height\": %d, \"frames\": %d, \"passes\": %d,\n", width, height, frames, passes);
+    fprintf(f, "  \"total_s\": %.4f, \"fps\": %.2f, \"mpixels_per_s\": %.2f,\n", total, frames/total, (double)width*height*frames/total*1e-6);
+    if (pr->gpu_log)
+    {
+        bench_stats(f, "cpu_ms", pr->cpu_log, pr->cpu_count, 0);
+        bench_stats(f, "gpu_ms", pr->gpu_log, pr->gpu_count, 1);
+    } else
+        bench_stats(f, "cpu_ms", pr->cpu_log, pr->cpu_count, 1);
+    fprintf(f, "}\n");
+    fflush(f);
+}
+
+#ifdef HAVE_CURL
+// cache warming for a list of shaders: the jsons on one thread per connection, then every
+// texture and cubemap face they reference in one batch
+typedef struct PREFETCH
+{
+    char **urls, **json, **media;
+    int *json_size;
+    int count, next, num_media, failed, media_failed, files;
+    double bytes;
+    pthread_mutex_t lock;
+} PREFETCH;
+
+static void *prefetch_thread(void *arg)
+{
+    PREFETCH *p = (PREFETCH *)arg;
+    for (;;)
+    {
+        pthread_mutex_lock(&p->lock);
+        int i = p->next++;
+        pthread_mutex_unlock(&p->lock);
+        if (i >= p->count)
+            return 0;
+        p->json[i] = load_shader_url(p->urls[i], &p->json_size[i], 0);
+    }
+}
+
+static void prefetch_downloaded(void *user, int index, char *data, int size)
+{
+    PREFETCH *p = (PREFETCH *)user;
+    if (!data)
+    {
+        p->media_failed++;
+        return;
+    }
+    store_put(p->media[index] + 26, 0, 0, data, size);
+    p->bytes += size, p->files++;
+    free(data);
+}
+
+static int compare_str(const void *a, const void *b)
+{
+    return strcmp(*(char * const *)a, *(char * const *)b);
+}
+
+static int compare_key(const void *a, const void *b)
+{
+    uint64_t ka = ((const STORE_ENTRY *)a)->key, kb = ((const STORE_ENTRY *)b)->key;
+    return ka < kb ? -1 : ka > kb;
+}
+
+static int prefetch(const char *list)
+{   // one shader id or url per line, # starts a comment
+    pthread_t threads[64];
+    PREFETCH p;
+    int size, capacity = 0, num_threads = 0, num_cached = 0, fd;
+    char *text = (char *)load_file(list, &size), *line, *next;
+    if (!text)
+    {
+        printf("error: opening %s failed\n", list);
+        return 1;
+    }
+    memset(&p, 0, sizeof(p));
+    pthread_mutex_init(&p.lock, NULL);
+    for (line = text; line; line = next)
+    {
+        if ((next = strchr(line, '\n')))
+            *next++ = 0;
+        line += strspn(line, " \t\r");
+        line[strcspn(line, " \t\r#")] = 0;
+        if (!*line)
+            continue;
+        if (p.count == capacity)
+        {
+            capacity = capacity ? capacity*2 : 256;
+            p.urls = (char **)realloc(p.urls, capacity*sizeof(char *));
+        }
+        char *url = (char *)malloc(strlen(line) + 40);
+        if (strstr(line, "://"))
+            strcpy(url, line);
+        else
+            sprintf(url, "https://www.shadertoy.com/view/%s", line);
+        p.urls[p.count++] = url;
+    }
+    free(text);
+    p.json = (char **)calloc(p.count + 1, sizeof(char *));
+    p.json_size = (int *)calloc(p.count + 1, sizeof(int));
+    p.media = (char **)malloc((p.count*(size_t)MAX_ASSETS + 1)*sizeof(char *));
+    double start = get_time();
+    store_batch(1);
+    for (int i = 0; i < _net.connections && i < 64 && i < p.count; i++)
+        if (!pthread_create(&threads[num_threads], NULL, prefetch_thread, &p))
+            num_threads++;
+    if (!num_threads)
+        prefetch_thread(&p);
+    for (int i = 0; i < num_threads; i++)
+        pthread_join(threads[i], NULL);
+    double json_time = get_time() - start;
+    store_batch(1); // shaders written, media lookups below see them
+    fd = store_lock();
+    STORE_ENTRY *cached = store_index_read(&num_cached, 0);
+    store_unlock(fd);
+    if (cached)
+        qsort(cached, num_cached, sizeof(STORE_ENTRY), compare_key);
+    for (int i = 0; i < p.count; i++)
+    {
+        ASSET assets[MAX_ASSETS];
+        int num_assets = 0;
+        SHADERTOY t;
+        memset(&t, 0, sizeof(t));
+        if (!p.json[i] || '[' != p.json[i][0] || load_json(&t, p.json[i], p.json_size[i], assets, &num_assets))
+        {
+            printf("error: %s is not a shader\n", p.urls[i]);
+            p.failed++;
+        } else
+            p.bytes += p.json_size[i];
+        shadertoy_delete(&t);
+        for (int k = 0; k < num_assets; k++)
+        {
+            STORE_ENTRY e;
+            e.key = fnv1a(assets[k].url + 26, strlen(assets[k].url + 26), FNV_OFFSET);
+            if (cached && bsearch(&e, cached, num_cached, sizeof(STORE_ENTRY), compare_key))
+                free(assets[k].url);
+            else
+                p.media[p.num_media++] = assets[k].url;
+        }
+        if (p.json[i])
+            free(p.json[i]);
+    }
+    if (cached)
+        free(cached);
+    // the same texture is used by many shaders
+    qsort(p.media, p.num_media, sizeof(char *), compare_str);
+    int unique = 0;
+    for (int i = 0; i < p.num_media; i++)
+        if (unique && !strcmp(p.media[unique - 1], p.media[i]))
+            free(p.media[i]);
+        else
+            p.media[unique++] = p.media[i];
+    p.num_media = unique;
+    if (_store.offline && p.num_media)
+        printf("warning: %d textures are not cached, --offline does not download them\n", p.num_media);
+    else
+        download_all((const char **)p.media, p.num_media, prefetch_downloaded, &p, 0);
+    store_batch(0);
+    double total = get_time() - start;
+    printf("prefetched %d shaders in %.2f s (%d failed), %d of %d new files (%d failed), %.1f MB in %.2f s, %.2f MB/s\n",
+        p.count, json_time, p.failed, p.files, p.num_media, p.media_failed, p.bytes/(1024*1024), total,
+        total > 0 ? p.bytes/(1024*1024)/total : 0.0);
+    for (int i = 0; i < p.count; i++)
+        free(p.urls[i]);
+    for (int i = 0; i < p.num_media; i++)
+        free(p.media[i]);
+    free(p.urls);
+    free(p.json);
+    free(p.json_size);
+    free(p.media);
+    pthread_mutex_destroy(&p.lock);
+    return p.failed || p.media_failed;
+}
+#endif
+
+int main(int argc, char **argv)
+{
+    int width = 600, height = 400, headless = 0, max_frames = 0, bench_frames = 0, profile = 0;
+    const char *src = 0, *output = 0, *profile_csv = 0, *cache_dir = 0, *cache_size = 0, *prefetch_list = 0;
+    char out_path[PATH_MAX], src_path[PATH_MAX], list_path[PATH_MAX];
+    for (int i = 1; i < argc; i++)
+    {
+        if (!strcmp(argv[i], "--headless"))
+            headless = 1;
+        else if (!strcmp(argv[i], "--size") && i + 1 < argc)
+            sscanf(argv[++i], "%dx%d", &width, &height);
+        else if (!strcmp(argv[i], "--frames") && i + 1 < argc)
+            max_frames = atoi(argv[++i]);
+        else if (!strcmp(argv[i], "--output") && i + 1 < argc)
+            output = argv[++i];
+        else if (!strcmp(argv[i], "--bench") && i + 1 < argc)
+            bench_frames = atoi(argv[++i]);
+        else if (!strcmp(argv[i], "--profile"))
+            profile = 1;
+        else if (!strcmp(argv[i], "--profile-csv") && i + 1 < argc)
+            profile_csv = argv[++i];
+        else if (!strcmp(argv[i], "--cache-dir") && i + 1 < argc)
+            cache_dir = argv[++i];
+        else if (!strcmp(argv[i], "--offline"))
+            _store.offline = 1;
+        else if (!strcmp(argv[i], "--cache-size") && i + 1 < argc)
+            cache_size = argv[++i];
+#ifdef HAVE_CURL
+        else if (!strcmp(argv[i], "--prefetch") && i + 1 < argc)
+            prefetch_list = argv[++i];
+        else if (!strcmp(argv[i], "--connections") && i + 1 < argc)
+            _net.connections = atoi(argv[++i]);
+        else if (!strcmp(argv[i], "--rate") && i + 1 < argc)
+            _net.rate = atof(argv[++i]);
+#endif
+        else
+            src = argv[i];
+    }
+#ifdef HAVE_CURL
+    if (_net.connections < 1)
+        _net.connections = 1;
+#endif
+    if ((!src && !prefetch_list) || width <= 0 || height <= 0)
+    {
+        printf("usage: toy [--headless] [--size WxH] [--frames N] [--output file.ppm] [--bench N]\n"
+               "           [--profile] [--profile-csv file|-] [--cache-dir dir] [--cache-size N[K|M|G]]\n"
+               "           [--offline] [--connections N] [--rate N] url or file\n"
+               "       toy --prefetch ids.txt [--connections N] [--rate N] [--cache-dir dir] [--cache-size N]\n");
+        return 0;
+    }
+    if (bench_frames > 0 && profile_csv && !strcmp(profile_csv, "-"))
+    {   // stdout carries only the benchmark json
+        printf("error: --profile-csv - can not be combined with --bench, write the csv to a file\n");
+        return 1;
+    }
+    FILE *bench_out = 0;
+    if (bench_frames > 0)
+    {   // the report owns stdout, every log line goes to stderr, before any thread prints
+        max_frames = bench_frames;
+        fflush(stdout);
+        bench_out = fdopen(dup(STDOUT_FILENO), "w");
+        dup2(STDERR_FILENO, STDOUT_FILENO);
+    }
+    if (headless && !max_frames)
+        max_frames = 1;
+    int is_url = src && strstr(src, "://");
+    // resolve before chdir, reloads read the source again
+    if (output)
+        output = abs_path(output, out_path);
+    char fname[PATH_MAX];
+    int output_frames = output ? output_name(fname, sizeof(fname), output, 0) : 0;
+    if (output_frames < 0)
+    {
+        printf("error: --output takes one %%d or %%0Nd for the frame number.\n");
+        return 1;
+    }
+    if (src && !is_url)
+        src = abs_path(src, src_path);
+    if (prefetch_list)
+        prefetch_list = abs_path(prefetch_list, list_path);
+    if (cache_dir)
+    {
+        char path[PATH_MAX];
+        snprintf(_store.root, sizeof(_store.root), "%s", abs_path(cache_dir, path));
+    }
+    FILE *csv = 0;
+    if (profile_csv)
+    {
+        csv = strcmp(profile_csv, "-") ? fopen(profile_csv, "w") : stdout;
+        if (!csv)
+        {
+            printf("error: opening %s failed\n", profile_csv);
+            return 1;
+        }
+    }
+
+    char result[PATH_MAX];
+    ssize_t count = readlink("/proc/self/exe", result, PATH_MAX);
+    int res = chdir(dirname(result));
+    (void)res;
+    if (cache_size)
+    {
+        char *end;
+        _store.budget = strtoull(cache_size, &end, 10);
+        if ('K' == *end || 'k' == *end)
+            _store.budget <<= 10;
+        else if ('M' == *end || 'm' == *end)
+            _store.budget <<= 20;
+        else if ('G' == *end || 'g' == *end)
+            _store.budget <<= 30;
+        store_trim();
+    }
+#ifdef HAVE_CURL
+    curl_global_init(CURL_GLOBAL_DEFAULT); // before any thread starts, libcurl before 7.84 requires it
+    if (prefetch_list)
+        return prefetch(prefetch_list);
+#endif
+    SHADERTOY toy;
+    _startup.src = src, _startup.is_url = is_url, _startup.toy = &toy;
+    int threaded = !pthread_create(&_startup.thread, NULL, startup_thread, NULL);
+    if (!threaded)
+        startup_thread(NULL);
+    gl_init(width, height, headless);
+    if (threaded)
+        pthread_join(_startup.thread, NULL);
+    if (!_startup.parsed)
+        return 1;
+    if (!shadertoy_supported(&toy))
+        return 1;
+    if (!_mainWindow && !fb_supported())
+    {   // offline output renders into a framebuffer object too
+        printf("error: headless rendering needs framebuffer objects, this context has none\n");
+        return 1;
+    }
+    common_claim(); // until the first reload
+    shadertoy_compile(&toy);
+#ifdef _DEBUG
+    if (toy.errors)
+        exit(1);
+#endif
+    if (!_mainWindow || bench_frames > 0)
+        shadertoy_pump(&toy, 1); // offline output and benchmarks start with every texture in place
+    struct stat st;
+    _reload.src = src;
+    if (!is_url && !stat(src, &st))
+        _reload.mtime = st.st_mtime;
+    int reload_key = 0, reloads = !max_frames; // a benchmark or a rendered sequence keeps its shader
+
+    PLATFORM_PARAMS p;
+    memset(&p, 0, sizeof(p));
+    FBO offscreen;
+    memset(&offscreen, 0, sizeof(offscreen));
+    if (!_mainWindow)
+    {
+        fb_init(&offscreen, width, height, 0);
+        p.framebuffer = offscreen.framebuffer;
+    }
+    PROFILER prof;
+    profiler_init(&prof, toy.num_passes, csv, profile, bench_frames);
+    if (bench_frames > 0 && _mainWindow)
+        glfwSwapInterval(0);
+    double time_start = get_time();
+    while (!(_mainWindow && glfwWindowShouldClose(_mainWindow)) && (!max_frames || p.frame < max_frames))
+    {
+        double frame_start = get_time();
+        p.cx = -1.0f, p.cy = -1.0f;
+        if (_mainWindow)
+        {
+            glfwPollEvents();
+            if (glfwGetKey(_mainWindow, GLFW_KEY_ESCAPE))
+                glfwSetWindowShouldClose(_mainWindow, 1);
+            int key = glfwGetKey(_mainWindow, GLFW_KEY_F5);
+            if (key && !reload_key && reloads)
+                reload_start();
+            reload_key = key;
+            double mx, my;
+            glfwGetWindowSize(_mainWindow, &p.winWidth, &p.winHeight);
+            glfwGetFramebufferSize(_mainWindow, &width, &height);
+            glfwGetCursorPos(_mainWindow, &mx, &my);
+            p.mx = mx, p.my = my;
+            if (GLFW_PRESS == glfwGetMouseButton(_mainWindow, GLFW_MOUSE_BUTTON_LEFT))
+            {
+                p.cx = mx, p.cy = my;
+            }
+            p.cur_time = glfwGetTime() - time_start;
+        } else
+        {   // offline rendering advances time at a fixed 60 fps so the output is reproducible
+            p.winWidth = width, p.winHeight = height;
+            p.cur_time = p.frame/60.0f;
+        }
+        if (reloads && reload_changed(frame_start))
+            reload_start();
+        if (reload_poll(&toy))
+            profiler_reset(&prof, toy.num_passes);
+        shadertoy_pump(&toy, 0);
+        glBindFramebuffer(GL_FRAMEBUFFER, p.framebuffer); GLCHK;
+        glViewport(0, 0, p.winWidth, p.winHeight); GLCHK;
+        glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT | GL_STENCIL_BUFFER_BIT); GLCHK;
+
+        time_t rawtime;
+        time(&rawtime);
+        p.tm = localtime(&rawtime);
+
+        profiler_begin(&prof, &p);
+        shadertoy_render(&toy, &p);
+        GLCHK_FRAME;
+        if (prof.overlay)
+            profiler_overlay(&prof, &p);
+        double swap_start = get_time();
+        if (_mainWindow)
+            glfwSwapBuffers(_mainWindow);
+        else if (output && (output_frames || p.frame + 1 == max_frames))
+        {   // "frame%04d.ppm" saves every frame
+            output_name(fname, sizeof(fname), output, p.frame);
+            save_ppm(fname, width, height);
+        }
+        double frame_end = get_time();
+        profiler_end(&prof, &p, (swap_start - frame_start)*1000.0, (frame_end - swap_start)*1000.0);
+        p.time_last = p.cur_time;
+        p.frame++;
+    }
+    profiler_flush(&prof, &p);
+    if (bench_frames > 0)
+    {
+        glFinish(); GLCHK;
+        bench_report(bench_out ? bench_out : stdout, src, p.winWidth, p.winHeight, p.frame, toy.num_passes, get_time() - time_start, &prof);
+    } else if (!_mainWindow)
+        printf("rendered %d frames in %.3f s\n", p.frame, get_time() - time_start);
+    profiler_delete(&prof);
+    if (csv && csv != stdout)
+        fclose(csv);
+    if (bench_out)
+        fclose(bench_out);
+    reload_close();
+    shadertoy_delete(&toy);
+    fb_delete(&offscreen);
+    if (_fullscreenVao)
+        glDeleteVertexArrays(1, &_fullscreenVao); GLCHK;
+    if (_vertexShader)
+        glDeleteShader(_vertexShader); GLCHK;
+    gl_close();
+    return 0;
+}
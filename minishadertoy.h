@@ -1,10 +1,19 @@
 #pragma once
 
 #ifdef _DEBUG
-void CheckGLErrors(const char *func, int line);
-#define GLCHK glFinish(); CheckGLErrors(__FUNCTION__, __LINE__);
+// errors arrive through a KHR_debug callback, without it glGetError() is polled once per frame
+// the callback is synchronous, so the state is per thread like the contexts
+#define GL_DEBUG_TLS __thread
+extern GL_DEBUG_TLS int gl_debug_pending, gl_debug_line;
+extern GL_DEBUG_TLS const char *gl_debug_file, *gl_debug_func;
+void CheckGLErrors(const char *file, const char *func, int line);
+void CheckGLFrameErrors();
+#define GLCHK do { gl_debug_file = __FILE__, gl_debug_func = __FUNCTION__, gl_debug_line = __LINE__; \
+    if (gl_debug_pending) CheckGLErrors(__FILE__, __FUNCTION__, __LINE__); } while (0)
+#define GLCHK_FRAME CheckGLFrameErrors()
 #else
 #define GLCHK
+#define GLCHK_FRAME
 #endif
 
 typedef struct FBO
@@ -12,7 +21,7 @@ typedef struct FBO
     const char *id;
     GLuint framebuffer;
     GLuint framebufferTex;
-    int floatTex;
+    int floatTex, width, height;
 } FBO;
 
 typedef struct SAMPLER
@@ -26,14 +35,33 @@ typedef struct SHADER_INPUT
     GLuint tex;
     int is_cubemap, w, h;
     SAMPLER sampler;
+    GLuint sampler_object; // buffer inputs only, created on first use
+    struct SHADER *buffer; // producing buffer pass, if any
 } SHADER_INPUT;
 
+typedef struct ASSET
+{
+    SHADER_INPUT *inp;
+    int face; // cubemap face, 0 for textures
+    char *url; // the local cache path starts at url + 26
+    char *data; // file contents, freed once decoded
+    int size, done;
+    unsigned char *pix; // decoded RGBA, already flipped
+    int w, h;
+    void *map; // decoded texture cache file pix points into, if any
+    size_t map_size;
+} ASSET;
+
 typedef struct SHADER
 {
     GLuint prog;
     GLuint shader;
     SHADER_INPUT inputs[4];
-    FBO output;
+    uint64_t binary_key; // program binary cache key, 0 when not saving
+    const char *code; // pass source and common code, kept until shader_finish() when linking
+    const char *common; // against the shared common object, in case that fails. Both point into SHADERTOY.source
+    FBO output[2]; // ping-pong pair, output[output_idx] holds the last rendered frame
+    int output_idx;
     int type;
 
     GLuint iResolution;
@@ -48,9 +76,50 @@ typedef struct SHADER
     GLuint iChannel[4];
 } SHADER;
 
+#define MAX_PASSES 5
+#define MAX_ASSETS (MAX_PASSES*4*6) // every channel a cubemap
+
+enum { PASS_NONE = -1, PASS_IMAGE, PASS_COMMON, PASS_BUFFER, PASS_CUBEMAP, PASS_SOUND }; // in "renderpass" type order, NONE marks unused slots
+
+typedef struct SHADERTOY
+{
+    SHADER shaders[MAX_PASSES];
+    int order[MAX_PASSES]; // render order, image pass last
+    int num_passes;
+    int errors; // passes that failed to compile or link
+    struct ASSET_LOADER *loader; // textures still loading, 0 once all are uploaded
+    char *code[MAX_PASSES]; // parsed pass sources waiting for a context to compile them
+    char *common_code;
+    char *source; // the loaded document, code and common_code point into it
+} SHADERTOY;
+
+#define PROFILER_FRAMES 2
+
+typedef struct PROFILER_FRAME
+{
+    GLuint queries[MAX_PASSES];
+    int frame; // -1 when the slot has nothing to read back
+    float cpu_ms, swap_ms;
+} PROFILER_FRAME;
+
+typedef struct PROFILER
+{
+    PROFILER_FRAME *frames; // query sets are read back one frame late, a benchmark reads its own set per frame after the run
+    int num_frames, num_passes, has_timer, wait, overlay;
+    FILE *csv;
+    double *cpu_log, *gpu_log; // benchmark samples, every frame's cpu time and the gpu times that resolved
+    int log_size, cpu_count, gpu_count;
+    double title_time;
+    // last resolved frame
+    int frame;
+    float pass_ms[MAX_PASSES], gpu_ms, cpu_ms, swap_ms;
+} PROFILER;
+
 typedef struct PLATFORM_PARAMS
 {
     int winWidth, winHeight, frame;
+    GLuint framebuffer; // image pass target, 0 for the window
+    GLuint *pass_queries; // optional GL_TIME_ELAPSED query per pass in render order
     float mx, my, cx, cy, cur_time, time_last;
     struct tm *tm;
 } PLATFORM_PARAMS;